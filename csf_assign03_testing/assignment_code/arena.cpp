@@ -0,0 +1,43 @@
+#include <cstdlib>
+#include <cstdint>
+#include "arena.h"
+
+using namespace std;
+
+Arena::Arena(size_t chunkSize) : chunkSize(chunkSize) {
+}
+
+Arena::~Arena() {
+    while (head != nullptr) {
+        Chunk *next = head->next;
+        free(head);
+        head = next;
+    }
+}
+
+void *Arena::allocate(size_t bytes, size_t align) {
+    // round the bump pointer up to the alignment, grow if it does not fit
+    uintptr_t p = (reinterpret_cast<uintptr_t>(cur) + align - 1) & ~(uintptr_t)(align - 1);
+    if (cur == nullptr || p + bytes > reinterpret_cast<uintptr_t>(end)) {
+        grow(bytes + align);
+        p = (reinterpret_cast<uintptr_t>(cur) + align - 1) & ~(uintptr_t)(align - 1);
+    }
+    cur = reinterpret_cast<char *>(p + bytes);
+    used += bytes;
+    return reinterpret_cast<void *>(p);
+}
+
+void Arena::grow(size_t minBytes) {
+    // big requests (like a huge tag array) get a chunk of their own
+    size_t size = sizeof(Chunk) + (minBytes > chunkSize ? minBytes : chunkSize);
+    Chunk *chunk = static_cast<Chunk *>(calloc(1, size));
+    if (chunk == nullptr) {
+        throw bad_alloc();
+    }
+    chunk->next = head;
+    chunk->size = size;
+    head = chunk;
+    cur = reinterpret_cast<char *>(chunk + 1);
+    end = reinterpret_cast<char *>(chunk) + size;
+    reserved += size;
+}
@@ -0,0 +1,56 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+
+// bump allocator that owns the simulation engine's structures (sets, policy
+// metadata, prefetcher tables, stats). everything gets carved out while the
+// engine is being set up, so the per-access path never goes to the heap, and
+// all of it is released in one go when the arena dies
+class Arena {
+public:
+    explicit Arena(size_t chunkSize = 1 << 20);
+    ~Arena();
+
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    // zero-filled memory with the requested alignment
+    void *allocate(size_t bytes, size_t align = alignof(std::max_align_t));
+
+    // array of n value-initialized objects; the arena never runs destructors
+    // so only trivially destructible types are allowed in here
+    template <typename T>
+    T *make(size_t n = 1) {
+        static_assert(std::is_trivially_destructible<T>::value,
+                      "arena objects are never destroyed");
+        T *p = static_cast<T *>(allocate(sizeof(T) * n, alignof(T)));
+        for (size_t i = 0; i < n; i++) {
+            new (p + i) T();
+        }
+        return p;
+    }
+
+    size_t bytesUsed() const { return used; }
+    size_t bytesReserved() const { return reserved; }
+
+private:
+    // chunks are chained through a header at the front of each block
+    struct Chunk {
+        Chunk *next;
+        size_t size;
+    };
+
+    void grow(size_t minBytes);
+
+    Chunk *head = nullptr;
+    char *cur = nullptr;
+    char *end = nullptr;
+    size_t chunkSize;
+    size_t used = 0;
+    size_t reserved = 0;
+};
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef AUDIT_H
+#define AUDIT_H
+
+// hooks for the malloc audit build (malloc_audit.cpp). they are weak symbols
+// so in the normal csim build they are null and the calls below do nothing
+extern "C" void csim_audit_warm() __attribute__((weak));
+extern "C" void csim_audit_done() __attribute__((weak));
+
+// call once setup is finished, allocations after this point are failures
+inline void auditWarm() {
+    if (csim_audit_warm) {
+        csim_audit_warm();
+    }
+}
+
+// call when the simulation loop is over, reports (and fails) the audit
+inline void auditDone() {
+    if (csim_audit_done) {
+        csim_audit_done();
+    }
+}
+
+#endif
@@ -0,0 +1,122 @@
+#include <cstring>
+#include "banks.h"
+
+using namespace std;
+
+namespace {
+
+unsigned log2u(unsigned n) {
+    unsigned bits = 0;
+    while ((1u << bits) < n) {
+        bits++;
+    }
+    return bits;
+}
+
+}
+
+bool parseBankOptions(Options &opts, BankConfig &config, string &error) {
+    unsigned long banks, ports, width;
+    if (!opts.getUnsigned("l1-banks", 0, banks, error) ||
+        !opts.getUnsigned("l1-ports", 0, ports, error) ||
+        !opts.getUnsigned("l1-bank-width", config.width, width, error)) {
+        return false;
+    }
+    string hash = opts.get("l1-bank-hash", "low");
+    if (hash == "low") {
+        config.hash = BankHash::LOW;
+    } else if (hash == "xor") {
+        config.hash = BankHash::XOR;
+    } else {
+        error = "--l1-bank-hash must be low or xor";
+        return false;
+    }
+    if (banks == 0 && (opts.has("l1-bank-width") || opts.has("l1-bank-hash"))) {
+        error = "--l1-bank-width and --l1-bank-hash need --l1-banks";
+        return false;
+    }
+    if (banks > IssueGroups::MAX_BANKS || (banks & (banks - 1)) != 0 ||
+        ports > IssueGroups::MAX_GROUP || width < 4 || width > 64 || (width & (width - 1)) != 0) {
+        error = "--l1-banks must be a power of two up to 64, --l1-ports at most 64 and "
+                "--l1-bank-width a power of two from 4 to 64 bytes";
+        return false;
+    }
+    config.banks = banks;
+    config.ports = ports;
+    config.width = width;
+    return true;
+}
+
+IssueGroups::IssueGroups(const BankConfig &config) : cfg(config) {
+    widthBits = log2u(cfg.width);
+    bankBits = log2u(cfg.banks);
+}
+
+unsigned IssueGroups::bankOf(uint32_t word) const {
+    uint32_t mask = cfg.banks - 1;
+    if (cfg.hash == BankHash::LOW || bankBits == 0) {
+        return word & mask;
+    }
+    unsigned bank = 0;
+    for (; word != 0; word >>= bankBits) {
+        bank ^= word & mask;
+    }
+    return bank;
+}
+
+unsigned long IssueGroups::issue(const TraceRecord &rec) {
+    if (rec.gap != 0 || groupSize == 0 || groupSize == MAX_GROUP) {
+        groups++;
+        groupSize = 0;
+        groupCycles = 1;
+        memset(bankUse, 0, sizeof(bankUse));
+    } else {
+        grouped++;
+    }
+
+    // the cycle of the group this access can go in: after the accesses that
+    // took the ports before it, and after the ones queued on its bank
+    uint32_t word = rec.addr >> widthBits;
+    unsigned portSlot = cfg.ports != 0 ? groupSize / cfg.ports : 0;
+    unsigned bankSlot = 0;
+    if (cfg.banks != 0) {
+        bool shared = false;
+        for (unsigned i = 0; i < groupSize && !shared; i++) {
+            shared = words[i] == word;
+        }
+        if (!shared) {
+            bankSlot = bankUse[bankOf(word)]++;
+            conflicts += bankSlot != 0;
+        }
+    }
+    words[groupSize++] = word;
+    if (groupSize > largest) {
+        largest = groupSize;
+    }
+
+    unsigned slot = bankSlot > portSlot ? bankSlot : portSlot;
+    if (slot < groupCycles) {
+        return 0;
+    }
+    unsigned long stall = slot + 1 - groupCycles;
+    groupCycles = slot + 1;
+    if (bankSlot > portSlot) {
+        conflictStall += stall;
+    } else {
+        portStall += stall;
+    }
+    return stall;
+}
+
+void IssueGroups::report(csim_report_fn emit, void *out) const {
+    emit(out, "L1 issue groups", (double) groups);
+    emit(out, "L1 accesses issued with the one before", (double) grouped);
+    emit(out, "L1 largest issue group", (double) largest);
+    if (cfg.banks != 0) {
+        emit(out, "L1 bank conflicts", (double) conflicts);
+        emit(out, "L1 bank conflict stall cycles", (double) conflictStall);
+    }
+    if (cfg.ports != 0) {
+        emit(out, "L1 port stall cycles", (double) portStall);
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef BANKS_H
+#define BANKS_H
+
+#include <cstdint>
+#include <string>
+#include "csim_policy.h"
+#include "options.h"
+#include "trace.h"
+
+// which bank a word goes to
+enum class BankHash : uint8_t {
+    LOW, // the low bits of the word number
+    XOR // every bankBits-wide slice of the word number xored together
+};
+
+// how many accesses the L1 takes in one cycle. banks is the number of
+// single-ported banks (0 for an unbanked cache), ports the accesses accepted
+// per cycle over all banks (0 for no limit). the model is off when both are 0
+struct BankConfig {
+    unsigned banks = 0;
+    unsigned ports = 0;
+    unsigned width = 8; // bytes per bank word, consecutive words go to different banks
+    BankHash hash = BankHash::LOW;
+
+    bool enabled() const { return banks != 0 || ports != 0; }
+};
+
+// fill in config from --l1-banks, --l1-ports, --l1-bank-width and
+// --l1-bank-hash. false (with error set) on bad values
+bool parseBankOptions(Options &opts, BankConfig &config, std::string &error);
+
+// records with a gap of 0 issue in the same cycle as the record before them.
+// such a run is an issue group, and an access in it waits for a port and for
+// its bank. accesses to the same bank word share the bank access. a group
+// then takes as many cycles as its busiest bank or its port count needs
+class IssueGroups {
+public:
+    explicit IssueGroups(const BankConfig &config);
+
+    // cycles rec stalls its group by, 0 if it fits in the cycles the group
+    // already takes
+    unsigned long issue(const TraceRecord &rec);
+
+    void report(csim_report_fn emit, void *out) const;
+
+    static const unsigned MAX_BANKS = 64;
+    // longer zero-gap runs are cut into groups of this many
+    static const unsigned MAX_GROUP = 64;
+
+private:
+    unsigned bankOf(uint32_t word) const;
+
+    BankConfig cfg;
+    unsigned widthBits = 0;
+    unsigned bankBits = 0;
+
+    unsigned groupSize = 0;
+    unsigned groupCycles = 0;
+    uint8_t bankUse[MAX_BANKS] = {}; // accesses on each bank in this group
+    uint32_t words[MAX_GROUP] = {};
+
+    unsigned long groups = 0;
+    unsigned long grouped = 0; // accesses that joined a group
+    unsigned largest = 0;
+    unsigned long conflicts = 0; // accesses that found their bank taken
+    unsigned long conflictStall = 0;
+    unsigned long portStall = 0;
+};
+
+#endif
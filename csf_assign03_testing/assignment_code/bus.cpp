@@ -0,0 +1,38 @@
+#include "bus.h"
+
+using namespace std;
+
+bool parseBusOptions(Options &opts, BusTiming &timing, string &error) {
+    unsigned long width, latency, burst;
+    if (!opts.getUnsigned("bus-width", 0, width, error) ||
+        !opts.getUnsigned("mem-latency", timing.latency, latency, error) ||
+        !opts.getUnsigned("burst", timing.burst, burst, error)) {
+        return false;
+    }
+    string restart = opts.get("critical-word", "none");
+    if (restart == "none") {
+        timing.restart = Restart::NONE;
+    } else if (restart == "restart") {
+        timing.restart = Restart::EARLY;
+    } else if (restart == "first") {
+        timing.restart = Restart::CRITICAL_FIRST;
+    } else {
+        error = "--critical-word must be none, restart or first";
+        return false;
+    }
+    if (width == 0) {
+        if (opts.has("mem-latency") || opts.has("burst") || opts.has("critical-word")) {
+            error = "--mem-latency, --burst and --critical-word need --bus-width";
+            return false;
+        }
+        return true;
+    }
+    if (width < 4 || width > 4096 || (width & (width - 1)) != 0 || latency == 0) {
+        error = "--bus-width must be a power of two from 4 to 4096 bytes and --mem-latency at least 1";
+        return false;
+    }
+    timing.width = width;
+    timing.latency = latency;
+    timing.burst = burst;
+    return true;
+}
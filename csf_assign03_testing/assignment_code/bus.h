@@ -0,0 +1,50 @@
+#ifndef BUS_H
+#define BUS_H
+
+#include <cstdint>
+#include <string>
+#include "options.h"
+
+// when a fill lets the access that missed go on
+enum class Restart : uint8_t {
+    NONE, // once the whole block is in
+    EARLY, // early restart: once the beat with the word is in, beats in order
+    CRITICAL_FIRST // critical word first: the beat with the word comes first
+};
+
+// how blocks move between memory and the cache: latency cycles to the first
+// beat of width bytes, then burst cycles per further beat. width 0 keeps the
+// flat model of 100 cycles per 4-byte word with the whole block waited for
+struct BusTiming {
+    unsigned width = 0;
+    unsigned latency = 100;
+    unsigned burst = 4;
+    Restart restart = Restart::NONE;
+
+    // cycles to move a whole block
+    unsigned long blockCycles(unsigned blockSize) const {
+        unsigned beats = blockSize > width ? blockSize / width : 1;
+        return latency + (unsigned long) (beats - 1) * burst;
+    }
+
+    // cycles from the start of a fill that began with the beat holding
+    // criticalBeat until the beat holding the byte at offset is in
+    unsigned long arrival(unsigned blockSize, unsigned criticalBeat, unsigned offset) const {
+        unsigned beats = blockSize > width ? blockSize / width : 1;
+        unsigned beat = offset / width;
+        switch (restart) {
+        case Restart::CRITICAL_FIRST:
+            return latency + (unsigned long) ((beat + beats - criticalBeat) % beats) * burst;
+        case Restart::EARLY:
+            return latency + (unsigned long) beat * burst;
+        default:
+            return blockCycles(blockSize);
+        }
+    }
+};
+
+// fill in timing from --bus-width, --mem-latency, --burst and
+// --critical-word. false (with error set) on bad values
+bool parseBusOptions(Options &opts, BusTiming &timing, std::string &error);
+
+#endif
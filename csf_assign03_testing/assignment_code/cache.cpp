@@ -0,0 +1,744 @@
+#include <cstring>
+#include <stdexcept>
+#include "cache.h"
+#include "throttle.h"
+
+using namespace std;
+
+namespace {
+
+unsigned log2u(unsigned n) {
+    unsigned bits = 0;
+    while ((1u << bits) < n) {
+        bits++;
+    }
+    return bits;
+}
+
+// csim_policy_config::alloc, policies get their tables from our arena
+void *arenaAlloc(void *arena, size_t bytes, size_t align) {
+    return static_cast<Arena *>(arena)->allocate(bytes, align);
+}
+
+}
+
+void writeSummary(const CacheStats &stats, ostream &out) {
+    out << "Total loads: " << stats.totalLoads << "\n";
+    out << "Total stores: " << stats.totalStores << "\n";
+    out << "Load hits: " << stats.loadHits << "\n";
+    out << "Load misses: " << stats.loadMisses << "\n";
+    out << "Store hits: " << stats.storeHits << "\n";
+    out << "Store misses: " << stats.storeMisses << "\n";
+    out << "Total cycles: " << stats.cycles << "\n";
+}
+
+Cache::Cache(const CacheConfig &config, Arena &arena) : cfg(config), policy(config.policy) {
+    // the index/tag split only depends on the geometry so work it out once
+    offsetBits = log2u(cfg.blockSize);
+    setBits = log2u(cfg.numSets);
+    setMask = (1u << setBits) - 1;
+    missPenalty = cfg.bus.width != 0 ? cfg.bus.blockCycles(cfg.blockSize) : 100 * (cfg.blockSize / 4);
+    liveWays = cfg.blocksPerSet;
+
+    size_t lines = (size_t) cfg.numSets * cfg.blocksPerSet;
+    if (cfg.partialTagBits == 0 || cfg.partialTagStudy) {
+        tags = arena.make<uint32_t>(lines);
+    }
+    flags = arena.make<uint8_t>(lines);
+    st = arena.make<CacheStats>();
+    if (cfg.tagFilter && tags != nullptr) {
+        fingerprints = static_cast<uint8_t *>(arena.allocate(lines, 64));
+    }
+    if (cfg.partialTagBits != 0) {
+        partialTags = arena.make<uint16_t>(lines);
+        partialMask = (uint16_t) ((1u << cfg.partialTagBits) - 1);
+        if (!cfg.partialTagStudy) {
+            unsigned sampled = cfg.numSets < MAX_SHADOW_SETS ? cfg.numSets : MAX_SHADOW_SETS;
+            shadowStride = cfg.numSets / sampled;
+            shadowTags = arena.make<uint32_t>((size_t) sampled * cfg.blocksPerSet);
+        }
+    }
+
+    // policy metadata is sized from what the policy declared up front
+    lineMetaBytes = policy->line_meta_bytes;
+    setMetaBytes = policy->set_meta_bytes;
+    lineMeta = static_cast<uint8_t *>(arena.allocate(lines * lineMetaBytes, 16));
+    setMeta = static_cast<uint8_t *>(arena.allocate((size_t) cfg.numSets * setMetaBytes, 16));
+    if (policy->on_hit_batch != nullptr) {
+        hitQueue = arena.make<csim_hit>(HIT_BATCH);
+    }
+
+    if (cfg.powerManaged) {
+        lastUse = arena.make<uint64_t>(lines);
+    }
+    if (cfg.banks.enabled()) {
+        void *mem = arena.allocate(sizeof(IssueGroups), alignof(IssueGroups));
+        issue = new (mem) IssueGroups(cfg.banks);
+    }
+    if (cfg.numPrefetchers != 0) {
+        readyAt = arena.make<uint64_t>(lines);
+        pfSource = arena.make<uint8_t>(lines);
+        pfStats = arena.make<PrefetchStats>(cfg.numPrefetchers);
+        pfQueue = arena.make<PrefetchQueue>();
+    }
+
+    csim_policy_config pc;
+    pc.num_sets = cfg.numSets;
+    pc.ways = cfg.blocksPerSet;
+    pc.block_size = cfg.blockSize;
+    pc.args = cfg.policyArgs;
+    pc.alloc = arenaAlloc;
+    pc.arena = &arena;
+    if (policy->create != nullptr) {
+        policyCtx = policy->create(&pc);
+        if (policyCtx == nullptr) {
+            throw invalid_argument(string("policy ") + policy->name + " rejected its arguments '" +
+                                   cfg.policyArgs + "'");
+        }
+    }
+    if (policy->init_set != nullptr) {
+        for (uint32_t s = 0; s < cfg.numSets; s++) {
+            policy->init_set(policyCtx, s, setMetaFor(s), lineMetaFor((size_t) s * cfg.blocksPerSet));
+        }
+    }
+}
+
+Cache::~Cache() {
+    if (policy->destroy != nullptr) {
+        policy->destroy(policyCtx);
+    }
+}
+
+void Cache::access(const TraceRecord &rec) {
+    // waiting for a port or a bank behind accesses issued in the same cycle
+    if (issue != nullptr) {
+        st->cycles += issue->issue(rec);
+    }
+
+    // bit manipulation to calc the index and tag
+    uint32_t setIndex = (rec.addr >> offsetBits) & setMask;
+    uint32_t tag = (uint32_t) ((uint64_t) rec.addr >> (offsetBits + setBits));
+
+    size_t base = (size_t) setIndex * cfg.blocksPerSet;
+    uint32_t firstInvalid;
+    uint32_t hitIndex = probe(base, tag, firstInvalid);
+    if (partialTags != nullptr) {
+        checkPartial(setIndex, base, tag, hitIndex);
+    }
+    timeCounter++; // timestamp has to increment for next access
+
+    csim_access acc;
+    acc.now = timeCounter;
+    acc.addr = rec.addr;
+    acc.gap = rec.gap;
+    acc.set = setIndex;
+    acc.is_store = rec.isStore;
+    bool hit = hitIndex != cfg.blocksPerSet;
+    PrefetchEvent event = hit ? PrefetchEvent::HIT : PrefetchEvent::MISS;
+    // only look at the hit line's flags when something could have set these
+    // bits, with the tag filter the probe has not touched them
+    if (hit && cfg.numPrefetchers != 0 && (flags[base + hitIndex] & PREFETCHED)) {
+        prefetchedHit(base + hitIndex);
+        event = PrefetchEvent::PREFETCH_HIT;
+    }
+    if (hit && drowsy != 0 && (flags[base + hitIndex] & DROWSY)) {
+        wake(base + hitIndex);
+    }
+
+    if (!rec.isStore) {
+        st->totalLoads++;
+        if (hit) {
+            st->loadHits++;
+            if (fillEnd > st->cycles && (rec.addr >> offsetBits) == fillBlock) {
+                waitForWord(rec.addr);
+            }
+            st->cycles += 1; // cache hit so you add a cycle
+            policyHit(acc, base, hitIndex);
+        } else {
+            st->loadMisses++;
+            busWait();
+            st->cycles += demandFetchCycles(rec.addr) + 1; // cache miss so get block from memory
+            allocate(acc, base, firstInvalid, tag);
+        }
+    } else {
+        st->totalStores++;
+        if (hit) {
+            st->storeHits++;
+            if (!cfg.writeBack) {
+                st->cycles += 1 + writeThroughCycles(rec.addr); // write cache and memory
+            } else {
+                st->cycles += 1;
+                flags[base + hitIndex] |= DIRTY; // mark dirty on write-back hit
+            }
+            policyHit(acc, base, hitIndex);
+        } else {
+            st->storeMisses++;
+            uint32_t way = CSIM_POLICY_BYPASS;
+            if (cfg.writeAllocate) {
+                busWait();
+                st->cycles += demandFetchCycles(rec.addr); // cache miss so get block from memory
+                way = allocate(acc, base, firstInvalid, tag);
+            } else if (policy->on_bypass != nullptr) {
+                flushHits();
+                policy->on_bypass(policyCtx, &acc, setMetaFor(acc.set), lineMetaFor(base));
+            }
+            if (way != CSIM_POLICY_BYPASS) {
+                // write depending on policy
+                if (!cfg.writeBack) {
+                    st->cycles += 1 + writeThroughCycles(rec.addr);
+                } else {
+                    st->cycles += 1;
+                    flags[base + way] |= DIRTY;
+                }
+            } else {
+                // no-write-allocate (or a bypass) so write directly to memory
+                st->cycles += writeThroughCycles(rec.addr);
+            }
+        }
+    }
+
+    if (cfg.numPrefetchers != 0) {
+        if (cfg.throttle != nullptr && event == PrefetchEvent::MISS) {
+            cfg.throttle->demandMiss(rec.addr >> offsetBits);
+        }
+        runPrefetchers(rec.addr >> offsetBits, event);
+    }
+
+    if (cfg.interval != 0 && ++intervalAccesses == cfg.interval) {
+        endInterval();
+    }
+}
+
+void Cache::endInterval() {
+    for (unsigned i = 0; i < cfg.numObservers; i++) {
+        cfg.observers[i]->intervalEnd(*this, intervals);
+    }
+    intervals++;
+    intervalAccesses = 0;
+}
+
+uint32_t Cache::probe(size_t base, uint32_t tag, uint32_t &firstInvalid) {
+    if (tags == nullptr) {
+        return probePartial(base, (uint16_t) (tag & partialMask), firstInvalid);
+    }
+    if (fingerprints != nullptr) {
+        return probeFiltered(base, tag, firstInvalid);
+    }
+    firstInvalid = cfg.blocksPerSet;
+    // iterate and search for hit, remembering the first empty line on the way
+    for (uint32_t i = 0; i < cfg.blocksPerSet; i++) {
+        size_t line = base + i;
+        if ((flags[line] & VALID) && tags[line] == tag) {
+            return i;
+        }
+        if (!(flags[line] & VALID) && firstInvalid == cfg.blocksPerSet) {
+            firstInvalid = i;
+        }
+    }
+    return cfg.blocksPerSet;
+}
+
+uint32_t Cache::probePartial(size_t base, uint16_t partial, uint32_t &firstInvalid) const {
+    // same walk as probe over the narrower column, the first match wins
+    firstInvalid = cfg.blocksPerSet;
+    if (cfg.blocksPerSet < 4) {
+        for (uint32_t i = 0; i < cfg.blocksPerSet; i++) {
+            size_t line = base + i;
+            if ((flags[line] & VALID) && partialTags[line] == partial) {
+                return i;
+            }
+            if (!(flags[line] & VALID) && firstInvalid == cfg.blocksPerSet) {
+                firstInvalid = i;
+            }
+        }
+        return cfg.blocksPerSet;
+    }
+
+    // four ways at a time, like probeFiltered over 16-bit lanes: flag the
+    // zero lanes of the tags xor the wanted one, then check each candidate
+    // in way order, since a lane above a real zero can be flagged too and
+    // an empty line can hold a stale tag. the flags of the same four ways
+    // give the first empty one
+    const uint64_t ones = 0x0001000100010001ull;
+    const uint64_t highs = 0x8000800080008000ull;
+    const uint32_t flagOnes = 0x01010101u * VALID;
+    for (uint32_t i = 0; i < cfg.blocksPerSet; i += 4) {
+        uint64_t word;
+        memcpy(&word, partialTags + base + i, sizeof(word));
+        uint64_t x = word ^ (ones * partial);
+        uint32_t valid;
+        memcpy(&valid, flags + base + i, sizeof(valid));
+        for (uint64_t m = (x - ones) & ~x & highs; m != 0; m &= m - 1) {
+            uint32_t way = i + __builtin_ctzll(m) / 16;
+            if ((flags[base + way] & VALID) && partialTags[base + way] == partial) {
+                return way;
+            }
+        }
+        uint32_t empty = ~valid & flagOnes;
+        if (empty != 0 && firstInvalid == cfg.blocksPerSet) {
+            firstInvalid = i + __builtin_ctz(empty) / 8;
+        }
+    }
+    return cfg.blocksPerSet;
+}
+
+uint32_t Cache::probeFiltered(size_t base, uint32_t tag, uint32_t &firstInvalid) {
+    // flags and tags stay untouched unless a fingerprint matches
+    uint8_t want = fingerprintOf(tag);
+    const uint8_t *fp = fingerprints + base;
+    bool readTag = false;
+    firstInvalid = cfg.blocksPerSet;
+    if (cfg.blocksPerSet < 8) {
+        for (uint32_t i = 0; i < cfg.blocksPerSet; i++) {
+            if (fp[i] == want) {
+                if (tags[base + i] == tag) {
+                    return i;
+                }
+                filterFalseMatches++;
+                readTag = true;
+            } else if (fp[i] == 0 && firstInvalid == cfg.blocksPerSet) {
+                firstInvalid = i;
+            }
+        }
+        filterMisses += !readTag;
+        return cfg.blocksPerSet;
+    }
+
+    // eight ways at a time: flag the zero bytes of the word xor the wanted
+    // fingerprint. a byte above a real zero can be flagged too, so every
+    // candidate is checked, but the lowest flag is always exact
+    const uint64_t ones = 0x0101010101010101ull;
+    const uint64_t highs = 0x8080808080808080ull;
+    for (uint32_t i = 0; i < cfg.blocksPerSet; i += 8) {
+        uint64_t word;
+        memcpy(&word, fp + i, sizeof(word));
+        uint64_t x = word ^ (ones * want);
+        for (uint64_t m = (x - ones) & ~x & highs; m != 0; m &= m - 1) {
+            uint32_t way = i + __builtin_ctzll(m) / 8;
+            if (fp[way] != want) {
+                continue;
+            }
+            if (tags[base + way] == tag) {
+                return way;
+            }
+            filterFalseMatches++;
+            readTag = true;
+        }
+        uint64_t empty = (word - ones) & ~word & highs;
+        if (empty != 0 && firstInvalid == cfg.blocksPerSet) {
+            firstInvalid = i + __builtin_ctzll(empty) / 8;
+        }
+    }
+    filterMisses += !readTag;
+    return cfg.blocksPerSet;
+}
+
+void Cache::storeTag(uint32_t set, size_t base, uint32_t way, uint32_t tag) {
+    if (tags != nullptr) {
+        tags[base + way] = tag;
+    }
+    if (fingerprints != nullptr) {
+        fingerprints[base + way] = fingerprintOf(tag);
+    }
+    if (partialTags != nullptr) {
+        partialTags[base + way] = (uint16_t) (tag & partialMask);
+        if (shadowTags != nullptr && set % shadowStride == 0) {
+            shadowTags[(size_t) (set / shadowStride) * cfg.blocksPerSet + way] = tag;
+        }
+    }
+}
+
+void Cache::checkPartial(uint32_t set, size_t base, uint32_t tag, uint32_t way) {
+    if (shadowTags != nullptr) {
+        // approximate mode: the partial tags decided, the shadow knows better
+        if (set % shadowStride != 0) {
+            return;
+        }
+        shadowAccesses++;
+        if (way != cfg.blocksPerSet) {
+            shadowHits++;
+            if (shadowTags[(size_t) (set / shadowStride) * cfg.blocksPerSet + way] != tag) {
+                falseHits++;
+            }
+        }
+        return;
+    }
+
+    // study mode: the full tags decided, see what partial tags would have said
+    uint16_t partial = (uint16_t) (tag & partialMask);
+    unsigned matches = 0;
+    bool wrongWay = false;
+    for (uint32_t i = 0; i < cfg.blocksPerSet; i++) {
+        if ((flags[base + i] & VALID) && partialTags[base + i] == partial) {
+            matches++;
+            wrongWay |= i != way;
+        }
+    }
+    falseMatches += wrongWay;
+    multiMatches += matches > 1;
+}
+
+uint32_t Cache::allocate(const csim_access &acc, size_t base, uint32_t firstInvalid, uint32_t tag,
+                         int prefetchSource) {
+    // the policy must see every earlier hit before it picks a victim
+    flushHits();
+    uint8_t *sm = setMetaFor(acc.set);
+    uint8_t *lm = lineMetaFor(base);
+    if (firstInvalid >= liveWays) {
+        firstInvalid = cfg.blocksPerSet; // only switched-off ways are empty
+    }
+    uint32_t way = policy->choose_victim(policyCtx, &acc, sm, lm, firstInvalid);
+    if (way == CSIM_POLICY_BYPASS) {
+        return way;
+    }
+    if (way >= cfg.blocksPerSet) {
+        throw out_of_range(string("policy ") + policy->name + " chose way " + to_string(way) +
+                           " in a set of " + to_string(cfg.blocksPerSet));
+    }
+    if (way >= liveWays) {
+        way = oldestLiveWay(base);
+    }
+
+    size_t line = base + way;
+    if (flags[line] & DROWSY) {
+        drowsy--;
+    }
+    if (flags[line] & VALID) {
+        // only the low tag bits with approximate partial tags, main.cpp keeps
+        // that mode away from the DRAM cache and the prefetchers
+        uint32_t victim = (tagAt(line) << setBits) | acc.set;
+        if (cfg.writeBack && (flags[line] & DIRTY)) {
+            st->cycles += writeBackCycles(victim << offsetBits); // write back dirty block
+        }
+        if (cfg.numPrefetchers != 0) {
+            if (flags[line] & PREFETCHED) {
+                pfStats[pfSource[line]].unused++;
+            }
+            for (unsigned i = 0; i < cfg.numPrefetchers; i++) {
+                cfg.prefetchers[i]->evicted(victim);
+            }
+            if (cfg.throttle != nullptr && prefetchSource >= 0) {
+                cfg.throttle->prefetchEvicted(prefetchSource, victim);
+            }
+        }
+    }
+    storeTag(acc.set, base, way, tag);
+    flags[line] = VALID;
+    if (lastUse != nullptr) {
+        lastUse[line] = acc.now;
+    }
+    policy->on_fill(policyCtx, &acc, sm, lm, way);
+    return way;
+}
+
+void Cache::policyHit(const csim_access &acc, size_t base, uint32_t way) {
+    if (lastUse != nullptr) {
+        lastUse[base + way] = acc.now;
+    }
+    if (hitQueue == nullptr) {
+        policy->on_hit(policyCtx, &acc, setMetaFor(acc.set), lineMetaFor(base), way);
+        return;
+    }
+    csim_hit &h = hitQueue[queuedHits++];
+    h.access = acc;
+    h.set_meta = setMetaFor(acc.set);
+    h.line_meta = lineMetaFor(base);
+    h.way = way;
+    if (queuedHits == HIT_BATCH) {
+        flushHits();
+    }
+}
+
+void Cache::flushHits() {
+    if (queuedHits != 0) {
+        policy->on_hit_batch(policyCtx, hitQueue, queuedHits);
+        queuedHits = 0;
+    }
+}
+
+void Cache::prefetchedHit(size_t line) {
+    PrefetchStats &ps = pfStats[pfSource[line]];
+    ps.useful++;
+    if (readyAt[line] > st->cycles) {
+        // the prefetch is still in flight, the access waits for the rest
+        ps.late++;
+        ps.lateCycles += readyAt[line] - st->cycles;
+        st->cycles = readyAt[line];
+    }
+    flags[line] &= ~PREFETCHED;
+}
+
+void Cache::busWait() {
+    if (cfg.numPrefetchers == 0 || busFreeAt <= st->cycles) {
+        return;
+    }
+    // demand misses go ahead of queued prefetches but still wait for the
+    // transfer that is on the bus right now
+    unsigned long wait = busFreeAt - st->cycles;
+    if (wait > missPenalty) {
+        wait = missPenalty;
+    }
+    st->cycles += wait;
+    busStall += wait;
+    busFreeAt += missPenalty;
+}
+
+unsigned long Cache::fetchCycles(uint32_t addr) {
+    if (cfg.lower == nullptr) {
+        return missPenalty;
+    }
+    return cfg.lower->read(addr >> offsetBits << offsetBits, cfg.blockSize);
+}
+
+unsigned long Cache::writeBackCycles(uint32_t addr) {
+    if (cfg.lower == nullptr) {
+        return missPenalty;
+    }
+    return cfg.lower->write(addr, cfg.blockSize);
+}
+
+unsigned long Cache::writeThroughCycles(uint32_t addr) {
+    if (cfg.lower == nullptr) {
+        return cfg.bus.width != 0 ? cfg.bus.latency : 100;
+    }
+    return cfg.lower->write(addr & ~3u, 4);
+}
+
+unsigned long Cache::demandFetchCycles(uint32_t addr) {
+    if (cfg.bus.width == 0 || cfg.lower != nullptr) {
+        return fetchCycles(addr);
+    }
+    // the rest of the previous fill still has the bus
+    unsigned long wait = fillEnd > st->cycles ? fillEnd - st->cycles : 0;
+    fillBusWaitCycles += wait;
+    unsigned offset = addr & (cfg.blockSize - 1);
+    fillBlock = addr >> offsetBits;
+    fillStart = st->cycles + wait;
+    fillCritical = offset / cfg.bus.width;
+    fillEnd = fillStart + missPenalty;
+    return wait + cfg.bus.arrival(cfg.blockSize, fillCritical, offset);
+}
+
+void Cache::waitForWord(uint32_t addr) {
+    uint64_t arrives =
+        fillStart + cfg.bus.arrival(cfg.blockSize, fillCritical, addr & (cfg.blockSize - 1));
+    if (arrives > st->cycles) {
+        wordWaits++;
+        wordWaitCycles += arrives - st->cycles;
+        st->cycles = arrives;
+    }
+}
+
+void Cache::runPrefetchers(uint32_t block, PrefetchEvent event) {
+    for (unsigned i = 0; i < cfg.numPrefetchers; i++) {
+        pfQueue->clear();
+        cfg.prefetchers[i]->observe(block, event, *pfQueue);
+        for (unsigned j = 0; j < pfQueue->size(); j++) {
+            issuePrefetch((*pfQueue)[j], i);
+        }
+    }
+}
+
+void Cache::issuePrefetch(uint32_t block, unsigned source) {
+    // too many transfers already queued on the bus, let this one go
+    if (busFreeAt > st->cycles + MAX_BACKLOG * missPenalty) {
+        pfStats[source].dropped++;
+        return;
+    }
+    uint32_t setIndex = block & setMask;
+    uint32_t tag = (uint32_t) ((uint64_t) block >> setBits);
+    size_t base = (size_t) setIndex * cfg.blocksPerSet;
+    uint32_t firstInvalid;
+    if (probe(base, tag, firstInvalid) != cfg.blocksPerSet) {
+        return; // already cached
+    }
+
+    // the policy sees a prefetch as a load fill at the current time
+    csim_access acc;
+    acc.now = timeCounter;
+    acc.addr = block << offsetBits;
+    acc.gap = 0;
+    acc.set = setIndex;
+    acc.is_store = 0;
+    uint32_t way = allocate(acc, base, firstInvalid, tag, (int) source);
+    if (way == CSIM_POLICY_BYPASS) {
+        return;
+    }
+
+    // prefetches go over the memory bus one after another, behind whatever
+    // is already in flight
+    size_t line = base + way;
+    uint64_t start = busFreeAt > st->cycles ? busFreeAt : st->cycles;
+    busFreeAt = start + fetchCycles(acc.addr);
+    flags[line] |= PREFETCHED;
+    pfSource[line] = (uint8_t) source;
+    readyAt[line] = busFreeAt;
+    pfStats[source].issued++;
+}
+
+void Cache::reportPrefetch(csim_report_fn emit, void *out) {
+    unsigned long misses = st->loadMisses + st->storeMisses;
+    unsigned long allUseful = 0;
+    for (unsigned i = 0; i < cfg.numPrefetchers; i++) {
+        allUseful += pfStats[i].useful;
+    }
+    for (unsigned i = 0; i < cfg.numPrefetchers; i++) {
+        const PrefetchStats &ps = pfStats[i];
+        string name = string("Prefetch ") + cfg.prefetchers[i]->name() + " ";
+        emit(out, (name + "issued").c_str(), (double) ps.issued);
+        emit(out, (name + "useful").c_str(), (double) ps.useful);
+        emit(out, (name + "late").c_str(), (double) ps.late);
+        emit(out, (name + "unused evicted").c_str(), (double) ps.unused);
+        emit(out, (name + "dropped").c_str(), (double) ps.dropped);
+        // accuracy: share of prefetches that were used
+        emit(out, (name + "accuracy").c_str(), ps.issued ? (double) ps.useful / ps.issued : 0.0);
+        // coverage: share of the misses we would have had that it removed
+        emit(out, (name + "coverage").c_str(),
+             misses + allUseful ? (double) ps.useful / (misses + allUseful) : 0.0);
+        // timeliness: share of useful prefetches that arrived before the demand
+        emit(out, (name + "timeliness").c_str(),
+             ps.useful ? (double) (ps.useful - ps.late) / ps.useful : 0.0);
+        emit(out, (name + "late cycles").c_str(), (double) ps.lateCycles);
+    }
+    if (cfg.numPrefetchers != 0) {
+        emit(out, "Prefetch bus stall cycles", (double) busStall);
+    }
+}
+
+void Cache::reportPartialTags(csim_report_fn emit, void *out) {
+    if (partialTags == nullptr) {
+        return;
+    }
+    emit(out, "Partial tag bits", (double) cfg.partialTagBits);
+    if (shadowTags != nullptr) {
+        emit(out, "Partial tag sampled accesses", (double) shadowAccesses);
+        emit(out, "Partial tag false hits", (double) falseHits);
+        emit(out, "Partial tag false hit rate", shadowHits ? (double) falseHits / shadowHits : 0.0);
+        // every false hit is a miss that got counted as a hit
+        emit(out, "Partial tag hit rate error",
+             shadowAccesses ? (double) falseHits / shadowAccesses : 0.0);
+    } else {
+        unsigned long accesses = st->totalLoads + st->totalStores;
+        emit(out, "Partial tag false matches", (double) falseMatches);
+        emit(out, "Partial tag false match rate", accesses ? (double) falseMatches / accesses : 0.0);
+        emit(out, "Partial tag multiple matches", (double) multiMatches);
+    }
+}
+
+void Cache::dropLine(size_t line, uint32_t set) {
+    if (flags[line] & VALID) {
+        if (cfg.writeBack && (flags[line] & DIRTY)) {
+            uint32_t victim = (tags[line] << setBits) | set;
+            st->cycles += writeBackCycles(victim << offsetBits);
+            gatedDirty++;
+        }
+    }
+    if (flags[line] & DROWSY) {
+        drowsy--;
+    }
+    flags[line] = 0;
+    if (fingerprints != nullptr) {
+        fingerprints[line] = 0;
+    }
+}
+
+void Cache::wake(size_t line) {
+    flags[line] &= ~DROWSY;
+    drowsy--;
+    wakes++;
+    st->cycles += DROWSY_WAKE;
+}
+
+uint32_t Cache::oldestLiveWay(size_t base) const {
+    uint32_t oldest = 0;
+    for (uint32_t i = 1; i < liveWays; i++) {
+        if (lastUse[base + i] < lastUse[base + oldest]) {
+            oldest = i;
+        }
+    }
+    return oldest;
+}
+
+void Cache::setActiveWays(unsigned ways) {
+    flushHits();
+    for (uint32_t s = 0; s <= setMask; s++) {
+        size_t base = (size_t) s * cfg.blocksPerSet;
+        for (uint32_t w = ways; w < liveWays; w++) {
+            dropLine(base + w, s);
+        }
+    }
+    liveWays = ways;
+}
+
+void Cache::setActiveSets(unsigned sets) {
+    flushHits();
+    unsigned newBits = log2u(sets);
+    uint32_t newMask = sets - 1;
+    // only the sets that are in use now can hold anything
+    for (uint32_t s = 0; s <= setMask; s++) {
+        size_t base = (size_t) s * cfg.blocksPerSet;
+        for (uint32_t w = 0; w < cfg.blocksPerSet; w++) {
+            size_t line = base + w;
+            if (!(flags[line] & VALID)) {
+                continue;
+            }
+            uint64_t block = (uint64_t) tags[line] << setBits | s;
+            if ((block & newMask) != s) {
+                dropLine(line, s);
+            } else {
+                tags[line] = (uint32_t) (block >> newBits);
+                if (fingerprints != nullptr) {
+                    fingerprints[line] = fingerprintOf(tags[line]);
+                }
+            }
+        }
+    }
+    setBits = newBits;
+    setMask = newMask;
+}
+
+void Cache::doze() {
+    size_t lines = (size_t) cfg.numSets * cfg.blocksPerSet;
+    for (size_t line = 0; line < lines; line++) {
+        flags[line] |= DROWSY;
+    }
+    drowsy = lines;
+}
+
+void Cache::reportBus(csim_report_fn emit, void *out) {
+    if (cfg.bus.width == 0) {
+        return;
+    }
+    emit(out, "Bus block transfer cycles", (double) missPenalty);
+    emit(out, "Bus hit-under-fill waits", (double) wordWaits);
+    emit(out, "Bus hit-under-fill wait cycles", (double) wordWaitCycles);
+    emit(out, "Bus busy wait cycles", (double) fillBusWaitCycles);
+}
+
+void Cache::reportBanks(csim_report_fn emit, void *out) {
+    if (issue != nullptr) {
+        issue->report(emit, out);
+    }
+}
+
+void Cache::reportTagFilter(csim_report_fn emit, void *out) {
+    if (fingerprints == nullptr) {
+        return;
+    }
+    // prefetch probes count too
+    emit(out, "Tag filter false matches", (double) filterFalseMatches);
+    emit(out, "Tag filter misses without a tag read", (double) filterMisses);
+}
+
+void Cache::finish() {
+    flushHits();
+    if (intervalAccesses != 0) {
+        endInterval();
+    }
+}
+
+void Cache::reportPolicy(csim_report_fn emit, void *out) {
+    if (policy->report != nullptr) {
+        policy->report(policyCtx, emit, out);
+    }
+}
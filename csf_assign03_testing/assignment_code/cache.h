@@ -0,0 +1,266 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <cstdint>
+#include <ostream>
+#include "arena.h"
+#include "banks.h"
+#include "bus.h"
+#include "csim_policy.h"
+#include "prefetch.h"
+#include "trace.h"
+
+class Cache;
+class PrefetchThrottle;
+
+// something that looks at the cache at the end of every interval of
+// CacheConfig::interval accesses (and once more for the final partial one)
+class IntervalObserver {
+public:
+    virtual void intervalEnd(Cache &cache, unsigned long interval) = 0;
+};
+
+// a level below the cache (dram_cache.h) that fills and write-backs go to
+// instead of plain memory. both return the cycles the demand side waits
+class LowerLevel {
+public:
+    virtual unsigned long read(uint32_t addr, unsigned bytes) = 0;
+    virtual unsigned long write(uint32_t addr, unsigned bytes) = 0;
+};
+
+// geometry and policies picked on the command line
+struct CacheConfig {
+    unsigned numSets = 1;
+    unsigned blocksPerSet = 1;
+    unsigned blockSize = 4;
+    bool writeAllocate = true;
+    bool writeBack = false;
+    const csim_policy *policy = nullptr; // replacement policy (see policy.h)
+    const char *policyArgs = "";
+    Prefetcher *const *prefetchers = nullptr; // consulted after every access
+    unsigned numPrefetchers = 0;
+    PrefetchThrottle *throttle = nullptr; // told about prefetch victims and demand misses
+    unsigned long interval = 0; // accesses per interval, 0 for no interval stats
+    IntervalObserver *const *observers = nullptr;
+    unsigned numObservers = 0;
+    unsigned partialTagBits = 0; // keep only this many low tag bits (1-16), 0 for full tags
+    bool partialTagStudy = false; // keep full tags as well and only count partial matches
+    LowerLevel *lower = nullptr; // nullptr: misses go straight to memory
+    bool powerManaged = false; // ways or sets may be switched off between intervals (power.h)
+    BusTiming bus; // how blocks come from memory when there is no lower level
+    bool tagFilter = false; // per-line 8-bit tag fingerprints decide most misses (full tags only)
+    BankConfig banks; // ports and banks that same-cycle (zero-gap) accesses compete for
+};
+
+// counters for the to-be-calculated statistics
+struct CacheStats {
+    unsigned long totalLoads = 0;
+    unsigned long totalStores = 0;
+    unsigned long loadHits = 0;
+    unsigned long loadMisses = 0;
+    unsigned long storeHits = 0;
+    unsigned long storeMisses = 0;
+    unsigned long cycles = 0;
+};
+
+// the seven summary lines csim prints, which is also what golden files hold
+void writeSummary(const CacheStats &stats, std::ostream &out);
+
+// the simulation engine. lines are kept as columns (tags, flags, policy
+// metadata) in one flat array per column indexed by set * blocksPerSet + way,
+// and every column lives in the arena handed to the constructor.
+// throws std::invalid_argument if the policy rejects its arguments
+class Cache {
+public:
+    Cache(const CacheConfig &config, Arena &arena);
+    ~Cache();
+
+    Cache(const Cache &) = delete;
+    Cache &operator=(const Cache &) = delete;
+
+    // simulate one trace record
+    void access(const TraceRecord &rec);
+
+    // call after the last access, hands any queued hits to the policy
+    void finish();
+
+    // the policy's own statistics, if it has any
+    void reportPolicy(csim_report_fn emit, void *out);
+
+    // accuracy, coverage and timeliness of each attached prefetcher
+    void reportPrefetch(csim_report_fn emit, void *out);
+    const PrefetchStats &prefetchStats(unsigned i) const { return pfStats[i]; }
+
+    // false hits (or, in study mode, false partial matches) of partial tags
+    void reportPartialTags(csim_report_fn emit, void *out);
+
+    // loads that waited for their word of a block still being filled, and
+    // misses that waited for the previous fill to leave the bus
+    void reportBus(csim_report_fn emit, void *out);
+
+    // issue groups and the cycles they lost to bank and port conflicts
+    void reportBanks(csim_report_fn emit, void *out);
+
+    // how often the fingerprints matched the wrong block, and the misses
+    // they decided on their own
+    void reportTagFilter(csim_report_fn emit, void *out);
+
+    const CacheConfig &config() const { return cfg; }
+    const CacheStats &stats() const { return *st; }
+
+    // power management (power.h), only between accesses. lines the new size
+    // no longer covers are written back if dirty and dropped. sets halve and
+    // double the index: lines whose block moves to another set are dropped,
+    // the rest keep their data under the longer (or shorter) tag
+    void setActiveWays(unsigned ways);
+    void setActiveSets(unsigned sets);
+    unsigned activeWays() const { return liveWays; }
+    unsigned activeSets() const { return setMask + 1; }
+    // every line goes drowsy: it keeps its data but the next hit on it
+    // pays DROWSY_WAKE extra cycles
+    void doze();
+    size_t drowsyLines() const { return drowsy; }
+    unsigned long drowsyWakes() const { return wakes; }
+    unsigned long gatedWriteBacks() const { return gatedDirty; }
+
+    static const unsigned DROWSY_WAKE = 1;
+
+private:
+    // bits kept in the flags column
+    enum : uint8_t {
+        VALID = 1, // does line contain valid data
+        DIRTY = 2, // dirty block or not
+        PREFETCHED = 4, // brought in by a prefetcher and not demanded yet
+        DROWSY = 8 // kept at retention voltage until it is hit
+    };
+
+    // hits queued for a policy with on_hit_batch
+    static const unsigned HIT_BATCH = 64;
+
+    // way holding tag in the set starting at base (blocksPerSet if absent),
+    // also finds the first empty way
+    uint32_t probe(size_t base, uint32_t tag, uint32_t &firstInvalid);
+    uint32_t probePartial(size_t base, uint16_t partial, uint32_t &firstInvalid) const;
+    // probe over the fingerprints, a tag is only read when its fingerprint
+    // matches
+    uint32_t probeFiltered(size_t base, uint32_t tag, uint32_t &firstInvalid);
+    // never 0, which marks an empty line
+    static uint8_t fingerprintOf(uint32_t tag) {
+        uint8_t f = (uint8_t) ((tag * 0x9e3779b1u) >> 24);
+        return f != 0 ? f : 1;
+    }
+    // the tag of a line and storing one, whichever tag columns are kept
+    uint32_t tagAt(size_t line) const { return tags != nullptr ? tags[line] : partialTags[line]; }
+    void storeTag(uint32_t set, size_t base, uint32_t way, uint32_t tag);
+    // compare the partial tag lookup against full tags where we have them
+    void checkPartial(uint32_t set, size_t base, uint32_t tag, uint32_t way);
+
+    // ask the policy where the block goes and put it there, paying for a dirty
+    // victim. returns the way used, or CSIM_POLICY_BYPASS
+    uint32_t allocate(const csim_access &acc, size_t base, uint32_t firstInvalid, uint32_t tag,
+                      int prefetchSource = -1);
+    void policyHit(const csim_access &acc, size_t base, uint32_t way);
+    void flushHits();
+
+    // first demand hit on a prefetched line: credit the prefetcher and wait
+    // for the data if it has not arrived yet
+    void prefetchedHit(size_t line);
+    // a demand miss waits for the prefetch transfer occupying the bus
+    void busWait();
+    // cycles to fetch the block holding addr, write one back, or write a word
+    // through, from the level below
+    unsigned long fetchCycles(uint32_t addr);
+    unsigned long writeBackCycles(uint32_t addr);
+    unsigned long writeThroughCycles(uint32_t addr);
+    // fetchCycles for a demand miss: with a bus model only until the word
+    // that missed arrives, and the rest of the fill is remembered
+    unsigned long demandFetchCycles(uint32_t addr);
+    // a load hit on the block being filled waits for its word
+    void waitForWord(uint32_t addr);
+    void runPrefetchers(uint32_t block, PrefetchEvent event);
+    void issuePrefetch(uint32_t block, unsigned source);
+    void endInterval();
+    // power management: write back and drop a line that is being switched
+    // off, wake a drowsy line, and the enabled way used least recently
+    void dropLine(size_t line, uint32_t set);
+    void wake(size_t line);
+    uint32_t oldestLiveWay(size_t base) const;
+
+    uint8_t *setMetaFor(uint32_t set) { return setMeta + (size_t) set * setMetaBytes; }
+    uint8_t *lineMetaFor(size_t base) { return lineMeta + base * lineMetaBytes; }
+
+    CacheConfig cfg;
+    unsigned offsetBits;
+    unsigned setBits;
+    uint32_t setMask;
+    unsigned long missPenalty; // cycles to move a whole block from/to memory
+
+    uint32_t *tags = nullptr; // tag bits so we know which memory block stored
+    uint8_t *flags;
+    CacheStats *st;
+    uint64_t timeCounter = 0; // this increments after an access
+
+    const csim_policy *policy;
+    void *policyCtx = nullptr;
+    uint8_t *lineMeta; // blocksPerSet * lineMetaBytes per set
+    uint8_t *setMeta;
+    size_t lineMetaBytes;
+    size_t setMetaBytes;
+    csim_hit *hitQueue = nullptr;
+    unsigned queuedHits = 0;
+
+    // prefetch state, only allocated when prefetchers are attached
+    uint64_t *readyAt = nullptr; // cycle the line's data arrives
+    uint8_t *pfSource = nullptr; // which prefetcher filled the line
+    PrefetchStats *pfStats = nullptr;
+    PrefetchQueue *pfQueue = nullptr;
+    uint64_t busFreeAt = 0; // cycle the last queued prefetch transfer ends
+    unsigned long busStall = 0; // demand cycles lost waiting behind prefetches
+    static const unsigned MAX_BACKLOG = 8; // transfers queued before prefetches drop
+
+    // partial tags: in the approximate mode they replace the tags column and
+    // a sample of the sets keeps full tags on the side to catch false hits,
+    // in study mode they sit next to the full tags
+    uint16_t *partialTags = nullptr;
+    uint16_t partialMask = 0;
+    uint32_t *shadowTags = nullptr; // full tags of every shadowStride-th set
+    uint32_t shadowStride = 1;
+    unsigned long shadowAccesses = 0;
+    unsigned long shadowHits = 0;
+    unsigned long falseHits = 0; // partial hit on a block the full tags miss
+    unsigned long falseMatches = 0; // study: a way matched that is not the block
+    unsigned long multiMatches = 0; // study: more than one way matched
+    static const unsigned MAX_SHADOW_SETS = 64;
+
+    // tag filter: a set's fingerprints are contiguous and 64-byte aligned, so
+    // up to 64 ways are one host cache line. non-zero exactly when VALID
+    uint8_t *fingerprints = nullptr;
+    unsigned long filterFalseMatches = 0; // fingerprint matched another block's
+    unsigned long filterMisses = 0; // misses decided without reading a tag
+
+    // power management. ways at or above liveWays are switched off, and
+    // lastUse lets us pick a victim among the rest when the policy (which
+    // knows nothing about it) picks a switched-off way
+    unsigned liveWays;
+    uint64_t *lastUse = nullptr;
+    size_t drowsy = 0; // lines currently drowsy
+    unsigned long wakes = 0;
+    unsigned long gatedDirty = 0; // dirty lines written back when switched off
+
+    // the last demand fill with a bus model: its block, when it started,
+    // the beat it started with and when its last beat is in
+    uint32_t fillBlock = 0;
+    uint64_t fillStart = 0;
+    unsigned fillCritical = 0;
+    uint64_t fillEnd = 0;
+    unsigned long wordWaits = 0;
+    unsigned long wordWaitCycles = 0;
+    unsigned long fillBusWaitCycles = 0;
+
+    IssueGroups *issue = nullptr; // only with banks or ports configured
+
+    unsigned long intervalAccesses = 0; // accesses so far in this interval
+    unsigned long intervals = 0; // completed intervals
+};
+
+#endif
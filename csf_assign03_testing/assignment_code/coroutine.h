@@ -0,0 +1,75 @@
+#ifndef COROUTINE_H
+#define COROUTINE_H
+
+#include <coroutine>
+#include <cstddef>
+#include <utility>
+#include "arena.h"
+#include "trace.h"
+
+// the chunk of records a worker is handing to its coroutines right now.
+// co_awaiting the feed always suspends; the worker resumes every coroutine
+// once per chunk and an empty chunk means the trace is over
+class ChunkFeed {
+public:
+    struct Chunk {
+        const TraceRecord *begin = nullptr;
+        const TraceRecord *end = nullptr;
+    };
+
+    void set(const TraceRecord *begin, const TraceRecord *end) { cur = Chunk{begin, end}; }
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<>) const noexcept {}
+    Chunk await_resume() const noexcept { return cur; }
+
+private:
+    Chunk cur;
+};
+
+// a coroutine whose frame is carved out of the arena passed as its first
+// parameter, so the frames of one worker's coroutines sit next to each other
+// and next to the engines they drive. it runs up to its first co_await when
+// called, and the frame is released with the arena
+class SimTask {
+public:
+    struct promise_type {
+        template <typename... Args>
+        static void *operator new(size_t bytes, Arena &arena, Args &&...) {
+            return arena.allocate(bytes);
+        }
+        static void operator delete(void *) noexcept {}
+
+        SimTask get_return_object() {
+            return SimTask(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { throw; }
+    };
+
+    SimTask(SimTask &&other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+    SimTask(const SimTask &) = delete;
+    SimTask &operator=(const SimTask &) = delete;
+    ~SimTask() {
+        if (handle) {
+            handle.destroy();
+        }
+    }
+
+    // run to the next co_await, nothing to do once the body has returned
+    void resume() {
+        if (!handle.done()) {
+            handle.resume();
+        }
+    }
+    bool done() const { return handle.done(); }
+
+private:
+    explicit SimTask(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+#endif
@@ -0,0 +1,210 @@
+// miss-address correlation prefetchers: a Markov successor table and a Global
+// History Buffer (Nesbit & Smith, HPCA 2004) used in G/AC mode. both train on
+// the miss stream (demand misses plus first hits on prefetched lines, so a
+// correct prefetch keeps the stream going) and keep all state in fixed-size
+// tables carved out of the engine arena
+#include "prefetch.h"
+
+using namespace std;
+
+namespace {
+
+unsigned roundUpPow2(unsigned n) {
+    unsigned p = 1;
+    while (p < n) {
+        p <<= 1;
+    }
+    return p;
+}
+
+// fibonacci hashing of a block address into a power of two table
+uint32_t hashBlock(uint32_t block, uint32_t mask) {
+    return (block * 2654435769u >> 7) & mask;
+}
+
+// each row remembers the last few distinct blocks that missed right after the
+// row's block, in a small circular buffer (newest at head - 1)
+class MarkovPrefetcher : public Prefetcher {
+public:
+    MarkovPrefetcher(const PrefetchConfig &config, Arena &arena) {
+        rows = roundUpPow2(config.markovRows);
+        ways = config.markovSuccessors;
+        rowTag = arena.make<uint32_t>(rows);
+        rowUsed = arena.make<uint8_t>(rows);
+        rowHead = arena.make<uint8_t>(rows);
+        successors = arena.make<uint32_t>((size_t) rows * ways);
+    }
+
+    const char *name() const override { return "markov"; }
+
+    void observe(uint32_t block, PrefetchEvent event, PrefetchQueue &out) override {
+        if (event == PrefetchEvent::HIT) {
+            return;
+        }
+        if (haveLast && lastMiss != block) {
+            record(lastMiss, block);
+        }
+        lastMiss = block;
+        haveLast = true;
+
+        // distance > 1 first follows the newest successor chain that far
+        uint32_t start = block;
+        for (unsigned d = 1; d < distance; d++) {
+            int row = find(start);
+            if (row < 0) {
+                return;
+            }
+            start = successor(row, 0);
+        }
+        int row = find(start);
+        if (row < 0) {
+            return;
+        }
+        for (unsigned i = 0; i < degree && i < rowUsed[row]; i++) {
+            out.push(successor(row, i));
+        }
+    }
+
+private:
+    int find(uint32_t block) const {
+        uint32_t row = hashBlock(block, rows - 1);
+        return (rowUsed[row] != 0 && rowTag[row] == block) ? (int) row : -1;
+    }
+
+    // i-th newest successor of a row
+    uint32_t successor(int row, unsigned i) const {
+        unsigned slot = (rowHead[row] + ways - 1 - i) % ways;
+        return successors[(size_t) row * ways + slot];
+    }
+
+    void record(uint32_t prev, uint32_t next) {
+        uint32_t row = hashBlock(prev, rows - 1);
+        uint32_t *succ = successors + (size_t) row * ways;
+        if (rowUsed[row] == 0 || rowTag[row] != prev) {
+            // conflicting block takes the row over
+            rowTag[row] = prev;
+            rowUsed[row] = 0;
+            rowHead[row] = 0;
+        }
+        for (unsigned i = 0; i < rowUsed[row]; i++) {
+            if (succ[i] == next) {
+                return;
+            }
+        }
+        succ[rowHead[row]] = next;
+        rowHead[row] = (uint8_t) ((rowHead[row] + 1) % ways);
+        if (rowUsed[row] < ways) {
+            rowUsed[row]++;
+        }
+    }
+
+    unsigned rows;
+    unsigned ways;
+    uint32_t *rowTag;
+    uint8_t *rowUsed; // valid successors in the row, 0 means empty row
+    uint8_t *rowHead; // next slot to overwrite
+    uint32_t *successors;
+    uint32_t lastMiss = 0;
+    bool haveLast = false;
+};
+
+// the history buffer is a circular array of misses, each linked to the
+// previous miss to the same block. the index table points at the newest
+// entry for a block, so walking the chain finds every recent occurrence and
+// the misses that followed each of them are the prediction
+class GhbPrefetcher : public Prefetcher {
+public:
+    GhbPrefetcher(const PrefetchConfig &config, Arena &arena) {
+        size = config.ghbSize;
+        indexSize = roundUpPow2(config.ghbIndexSize);
+        history = arena.make<Entry>(size);
+        indexTag = arena.make<uint32_t>(indexSize);
+        indexSeq = arena.make<uint64_t>(indexSize);
+    }
+
+    const char *name() const override { return "ghb"; }
+
+    void observe(uint32_t block, PrefetchEvent event, PrefetchQueue &out) override {
+        if (event == PrefetchEvent::HIT) {
+            return;
+        }
+        // sequence numbers are stored +1 so that 0 means no entry
+        uint32_t slot = hashBlock(block, indexSize - 1);
+        uint64_t prev = (indexSeq[slot] != 0 && indexTag[slot] == block) ? indexSeq[slot] : 0;
+        Entry &e = history[head % size];
+        e.block = block;
+        e.link = prev;
+        indexTag[slot] = block;
+        indexSeq[slot] = head + 1;
+        uint64_t self = head;
+        head++;
+
+        // walk back through earlier occurrences until degree blocks are found
+        unsigned found = 0;
+        for (unsigned depth = 0; depth < MAX_CHAIN && prev != 0 && live(prev - 1); depth++) {
+            uint64_t seq = prev - 1;
+            for (unsigned k = distance; k < distance + degree && found < degree; k++) {
+                uint64_t next = seq + k;
+                if (next >= self) {
+                    break;
+                }
+                uint32_t candidate = history[next % size].block;
+                if (candidate != block && !queued(out, candidate)) {
+                    out.push(candidate);
+                    found++;
+                }
+            }
+            if (found >= degree) {
+                break;
+            }
+            prev = history[seq % size].link;
+        }
+    }
+
+private:
+    static const unsigned MAX_CHAIN = 4;
+
+    struct Entry {
+        uint32_t block;
+        uint64_t link; // sequence + 1 of the previous miss to block, 0 if none
+    };
+
+    // entries older than one trip around the buffer have been overwritten
+    bool live(uint64_t seq) const {
+        return seq < head && head - seq <= size;
+    }
+
+    static bool queued(const PrefetchQueue &out, uint32_t block) {
+        for (unsigned i = 0; i < out.size(); i++) {
+            if (out[i] == block) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    unsigned size;
+    unsigned indexSize;
+    Entry *history;
+    uint32_t *indexTag;
+    uint64_t *indexSeq;
+    uint64_t head = 0; // sequence number of the next entry
+};
+
+}
+
+Prefetcher *makeMarkovPrefetcher(const PrefetchConfig &config, Arena &arena) {
+    void *mem = arena.allocate(sizeof(MarkovPrefetcher), alignof(MarkovPrefetcher));
+    Prefetcher *p = new (mem) MarkovPrefetcher(config, arena);
+    p->degree = config.degree;
+    p->distance = config.distance;
+    return p;
+}
+
+Prefetcher *makeGhbPrefetcher(const PrefetchConfig &config, Arena &arena) {
+    void *mem = arena.allocate(sizeof(GhbPrefetcher), alignof(GhbPrefetcher));
+    Prefetcher *p = new (mem) GhbPrefetcher(config, arena);
+    p->degree = config.degree;
+    p->distance = config.distance;
+    return p;
+}
@@ -0,0 +1,361 @@
+// csim-bench: microbenchmarks of the engine's kernels in isolation. each
+// benchmark runs its kernel over a fixed batch of operations a number of
+// times and reports ns per operation as the mean, standard deviation and
+// minimum over those samples
+//   decode      readTrace over a recorded trace and a synthetic one, as text
+//               and as binary, already in memory
+//   access      Cache::access at 1 to 64 ways on streams that always hit
+//               (the set scan plus the policy's hit update) and always miss
+//               (the scan of a full set, the victim search and the fill),
+//               with and without --tag-filter
+//   policy      every policy's on_hit, and choose_victim plus on_fill on
+//               full sets, called straight through the C ABI
+//   summary     writeSummary of the seven counters
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "arena.h"
+#include "cache.h"
+#include "options.h"
+#include "policy.h"
+#include "trace.h"
+
+using namespace std;
+
+namespace {
+
+// results feed this so the compiler cannot drop a kernel
+volatile uint64_t sink;
+
+struct Timing {
+    string name;
+    size_t ops;
+    double mean, stddev, min; // ns per op
+};
+
+class Bench {
+public:
+    Bench(unsigned samples, const string &filter) : samples(samples), filter(filter) {}
+
+    // body runs ops operations and returns something derived from them. one
+    // untimed run warms caches and branch predictors first
+    template <typename Body>
+    void run(const string &name, size_t ops, Body body) {
+        if (name.find(filter) == string::npos || ops == 0) {
+            return;
+        }
+        sink = sink + body();
+        vector<double> ns;
+        for (unsigned s = 0; s < samples; s++) {
+            auto start = chrono::steady_clock::now();
+            sink = sink + body();
+            auto end = chrono::steady_clock::now();
+            ns.push_back(chrono::duration<double, nano>(end - start).count() / ops);
+        }
+        Timing t{name, ops, 0, 0, ns[0]};
+        for (double v : ns) {
+            t.mean += v / ns.size();
+            t.min = v < t.min ? v : t.min;
+        }
+        for (double v : ns) {
+            t.stddev += (v - t.mean) * (v - t.mean) / ns.size();
+        }
+        t.stddev = sqrt(t.stddev);
+        print(t);
+    }
+
+private:
+    void print(const Timing &t) {
+        if (!header) {
+            cout << left << setw(32) << "benchmark" << right << setw(10) << "ops" << setw(10)
+                 << "ns/op" << setw(10) << "stddev" << setw(8) << "cv%" << setw(10) << "min" << "\n";
+            header = true;
+        }
+        cout << left << setw(32) << t.name << right << setw(10) << t.ops << fixed << setprecision(2)
+             << setw(10) << t.mean << setw(10) << t.stddev << setprecision(1) << setw(8)
+             << (t.mean > 0 ? 100 * t.stddev / t.mean : 0.0) << setprecision(2) << setw(10) << t.min
+             << defaultfloat << setprecision(6) << "\n";
+    }
+
+    unsigned samples;
+    string filter;
+    bool header = false;
+};
+
+uint64_t xorshift(uint64_t &state) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+// records spread over a few MB with a tenth of them stores, like the traces
+vector<TraceRecord> syntheticRecords(size_t count) {
+    uint64_t state = 88172645463325252ull;
+    vector<TraceRecord> records(count);
+    for (TraceRecord &rec : records) {
+        uint64_t r = xorshift(state);
+        rec.addr = 0x10000000u + ((uint32_t) r & 0x3ffffc);
+        rec.gap = (r >> 32) % 8;
+        rec.isStore = (r >> 40) % 10 == 0;
+    }
+    return records;
+}
+
+// the records as a text or binary trace in memory
+string encode(const vector<TraceRecord> &records, bool binary) {
+    char *data = nullptr;
+    size_t size = 0;
+    FILE *out = open_memstream(&data, &size);
+    if (binary) {
+        writeBinaryHeader(out);
+    }
+    unique_ptr<RecordBatch> batch(new RecordBatch);
+    for (size_t i = 0; i < records.size(); i += RecordBatch::CAPACITY) {
+        batch->count = min(RecordBatch::CAPACITY, records.size() - i);
+        copy(records.begin() + i, records.begin() + i + batch->count, batch->records);
+        writeRecords(out, *batch, binary);
+    }
+    fclose(out);
+    string bytes(data, size);
+    free(data);
+    return bytes;
+}
+
+void benchDecode(Bench &bench, const string &label, const vector<TraceRecord> &records) {
+    for (bool binary : {false, true}) {
+        string bytes = encode(records, binary);
+        vector<TraceRecord> decoded;
+        string error;
+        bench.run("decode " + string(binary ? "binary " : "text ") + label, records.size(), [&] {
+            decoded.clear();
+            FILE *in = fmemopen(&bytes[0], bytes.size(), "rb");
+            readTrace(in, decoded, error);
+            fclose(in);
+            return (uint64_t) decoded.size();
+        });
+    }
+}
+
+const unsigned ACCESS_SETS = 64;
+const unsigned ACCESS_BLOCK = 16;
+const size_t ACCESS_OPS = 1 << 18;
+
+// a stream hitting the blocks a warm-up pass left in every way, and one that
+// never comes back to a block so every access misses a full set
+void benchAccess(Bench &bench, unsigned ways, bool filter) {
+    CacheConfig config;
+    config.numSets = ACCESS_SETS;
+    config.blocksPerSet = ways;
+    config.blockSize = ACCESS_BLOCK;
+    config.writeAllocate = true;
+    config.writeBack = true;
+    config.policy = findBuiltinPolicy("lru");
+    config.tagFilter = filter;
+
+    uint64_t state = 2463534242ull;
+    uint32_t resident = ACCESS_SETS * ways;
+    vector<TraceRecord> warm(resident), hits(ACCESS_OPS), misses(ACCESS_OPS);
+    for (uint32_t b = 0; b < resident; b++) {
+        warm[b].addr = b * ACCESS_BLOCK;
+    }
+    for (TraceRecord &rec : hits) {
+        rec.addr = (uint32_t) (xorshift(state) % resident) * ACCESS_BLOCK;
+    }
+    for (size_t i = 0; i < misses.size(); i++) {
+        misses[i].addr = (uint32_t) (resident + i) * ACCESS_BLOCK;
+    }
+
+    string suffix = "/" + to_string(ways) + (filter ? " filter" : "");
+    Arena arena;
+    Cache hitCache(config, arena);
+    for (const TraceRecord &rec : warm) {
+        hitCache.access(rec);
+    }
+    bench.run("access hit" + suffix, hits.size(), [&] {
+        for (const TraceRecord &rec : hits) {
+            hitCache.access(rec);
+        }
+        return hitCache.stats().loadHits;
+    });
+    Cache missCache(config, arena);
+    for (const TraceRecord &rec : warm) {
+        missCache.access(rec);
+    }
+    bench.run("access miss" + suffix, misses.size(), [&] {
+        for (const TraceRecord &rec : misses) {
+            missCache.access(rec);
+        }
+        return missCache.stats().loadMisses;
+    });
+}
+
+void *benchAlloc(void *arena, size_t bytes, size_t align) {
+    return static_cast<Arena *>(arena)->allocate(bytes, align);
+}
+
+const unsigned POLICY_SETS = 1024;
+const unsigned POLICY_WAYS = 16;
+const size_t POLICY_OPS = 1 << 18;
+
+void benchPolicy(Bench &bench, const string &text) {
+    PolicySpec spec;
+    string error;
+    if (!loadPolicy(text, spec, error)) {
+        return;
+    }
+    const csim_policy *policy = spec.policy;
+    Arena arena;
+    csim_policy_config pc;
+    pc.num_sets = POLICY_SETS;
+    pc.ways = POLICY_WAYS;
+    pc.block_size = ACCESS_BLOCK;
+    pc.args = spec.args.c_str();
+    pc.alloc = benchAlloc;
+    pc.arena = &arena;
+    void *ctx = policy->create != nullptr ? policy->create(&pc) : nullptr;
+    size_t lineBytes = policy->line_meta_bytes * POLICY_WAYS;
+    uint8_t *lineMeta = static_cast<uint8_t *>(arena.allocate(lineBytes * POLICY_SETS, 16));
+    uint8_t *setMeta =
+        static_cast<uint8_t *>(arena.allocate((size_t) policy->set_meta_bytes * POLICY_SETS, 16));
+    for (uint32_t s = 0; s < POLICY_SETS && policy->init_set != nullptr; s++) {
+        policy->init_set(ctx, s, setMeta + (size_t) s * policy->set_meta_bytes, lineMeta + s * lineBytes);
+    }
+
+    // the same kind of accesses the engine would send, block addresses that
+    // map to the set they are handed with
+    uint64_t state = 1181783497276652981ull;
+    vector<csim_access> accesses(POLICY_OPS);
+    vector<uint32_t> ways(POLICY_OPS);
+    for (size_t i = 0; i < accesses.size(); i++) {
+        uint64_t r = xorshift(state);
+        csim_access &acc = accesses[i];
+        acc.set = r % POLICY_SETS;
+        acc.addr = (uint32_t) ((r >> 16) % 4096 * POLICY_SETS + acc.set) * ACCESS_BLOCK;
+        acc.gap = 0;
+        acc.is_store = (r >> 40) % 10 == 0;
+        ways[i] = (r >> 48) % POLICY_WAYS;
+    }
+    uint64_t now = 0;
+    auto metaFor = [&](uint32_t set, uint8_t *&sm, uint8_t *&lm) {
+        sm = setMeta + (size_t) set * policy->set_meta_bytes;
+        lm = lineMeta + set * lineBytes;
+    };
+
+    // fill every way once so the victim search sees full sets
+    for (uint32_t s = 0; s < POLICY_SETS; s++) {
+        for (uint32_t w = 0; w < POLICY_WAYS; w++) {
+            csim_access acc = accesses[(s * POLICY_WAYS + w) % accesses.size()];
+            acc.set = s;
+            acc.now = ++now;
+            uint8_t *sm, *lm;
+            metaFor(s, sm, lm);
+            uint32_t way = policy->choose_victim(ctx, &acc, sm, lm, w);
+            if (way != CSIM_POLICY_BYPASS) {
+                policy->on_fill(ctx, &acc, sm, lm, way);
+            }
+        }
+    }
+    if (policy->on_hit != nullptr) {
+        bench.run("policy " + string(policy->name) + " hit", accesses.size(), [&] {
+            for (size_t i = 0; i < accesses.size(); i++) {
+                csim_access &acc = accesses[i];
+                acc.now = ++now;
+                uint8_t *sm, *lm;
+                metaFor(acc.set, sm, lm);
+                policy->on_hit(ctx, &acc, sm, lm, ways[i]);
+            }
+            return now;
+        });
+    }
+    bench.run("policy " + string(policy->name) + " victim+fill", accesses.size(), [&] {
+        uint64_t sum = 0;
+        for (csim_access &acc : accesses) {
+            acc.now = ++now;
+            uint8_t *sm, *lm;
+            metaFor(acc.set, sm, lm);
+            uint32_t way = policy->choose_victim(ctx, &acc, sm, lm, POLICY_WAYS);
+            if (way != CSIM_POLICY_BYPASS) {
+                policy->on_fill(ctx, &acc, sm, lm, way);
+            }
+            sum += way;
+        }
+        return sum;
+    });
+    if (policy->destroy != nullptr) {
+        policy->destroy(ctx);
+    }
+}
+
+void benchSummary(Bench &bench) {
+    CacheStats stats;
+    stats.totalLoads = 318197;
+    stats.totalStores = 197486;
+    stats.loadHits = 314171;
+    stats.loadMisses = 4026;
+    stats.storeHits = 188047;
+    stats.storeMisses = 9439;
+    stats.cycles = 9344483;
+    ostringstream out;
+    const size_t ops = 1 << 12;
+    bench.run("summary", ops, [&] {
+        for (size_t i = 0; i < ops; i++) {
+            out.str("");
+            writeSummary(stats, out);
+        }
+        return (uint64_t) out.tellp();
+    });
+}
+
+}
+
+int main(int argc, char **argv) {
+    Options opts;
+    string error;
+    unsigned long samples, synthetic;
+    if (!opts.parse(argc, argv, 1, error) || !opts.getUnsigned("samples", 10, samples, error) ||
+        !opts.getUnsigned("synthetic", 1 << 19, synthetic, error)) {
+        cerr << "Error: " << error << "\n";
+        return 1;
+    }
+    string tracePath = opts.get("trace", "../traces/gcc.trace");
+    string filter = opts.get("filter", "");
+    if (!opts.firstUnused().empty() || samples == 0) {
+        cerr << "Usage: ./csim-bench [--samples=10] [--filter=<name part>] "
+                "[--trace=../traces/gcc.trace] [--synthetic=524288]\n";
+        return 1;
+    }
+
+    vector<TraceRecord> recorded;
+    error = "could not open it";
+    FILE *in = fopen(tracePath.c_str(), "rb");
+    bool ok = in != nullptr && readTrace(in, recorded, error);
+    if (in != nullptr) {
+        fclose(in);
+    }
+    if (!ok) {
+        cerr << "Error: " << tracePath << ": " << error << "\n";
+        return 1;
+    }
+
+    Bench bench(samples, filter);
+    benchDecode(bench, "recorded", recorded);
+    benchDecode(bench, "synthetic", syntheticRecords(synthetic));
+    for (bool tagFilter : {false, true}) {
+        for (unsigned ways = 1; ways <= 64; ways *= 4) {
+            benchAccess(bench, ways, tagFilter);
+        }
+    }
+    for (const char *policy : {"lru", "fifo", "perceptron", "hawkeye", "./srrip.so"}) {
+        benchPolicy(bench, policy);
+    }
+    benchSummary(bench);
+    return 0;
+}
@@ -0,0 +1,119 @@
+/*
+ * C ABI for csim replacement policies.
+ *
+ * A policy is a table of callbacks plus the number of metadata bytes it wants
+ * per line and per set. The engine allocates that metadata next to its own
+ * columns and hands the policy raw byte pointers, so a policy never sees the
+ * engine's data structures and plugins built against this header keep working
+ * as the engine changes.
+ *
+ * Built-in policies (lru, fifo, ...) use the same table. Plugins are shared
+ * objects that export CSIM_POLICY_ENTRY; csim loads them with dlopen when the
+ * policy argument is a path, e.g. ./csim 256 4 16 ... ./srrip.so:3
+ */
+#ifndef CSIM_POLICY_H
+#define CSIM_POLICY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CSIM_POLICY_ABI_VERSION 2
+/* version 1 tables end at report and are still loaded, without on_bypass */
+#define CSIM_POLICY_ABI_VERSION_MIN 1
+
+/* returned by choose_victim to leave the block out of the cache */
+#define CSIM_POLICY_BYPASS 0xffffffffu
+
+/* name of the function a plugin exports, see csim_policy_entry_fn */
+#define CSIM_POLICY_ENTRY "csim_policy_entry"
+
+/* the access being handled */
+typedef struct csim_access {
+    uint64_t now; /* access counter, 1 for the first access of the run */
+    uint32_t addr; /* byte address from the trace */
+    uint32_t gap; /* third trace field */
+    uint32_t set; /* set index */
+    uint32_t is_store; /* 0 for loads, 1 for stores */
+} csim_access;
+
+/* one entry of a batched on_hit call */
+typedef struct csim_hit {
+    csim_access access;
+    uint8_t *set_meta; /* set_meta_bytes for the set */
+    uint8_t *line_meta; /* ways * line_meta_bytes, line i at i * line_meta_bytes */
+    uint32_t way;
+} csim_hit;
+
+/* what a policy is told when it is created */
+typedef struct csim_policy_config {
+    uint32_t num_sets;
+    uint32_t ways;
+    uint32_t block_size;
+    const char *args; /* text after ':' in the policy argument, "" if none */
+
+    /* zero-filled memory owned by the engine, freed with it. use this for
+     * tables so nothing has to be allocated once the run is going */
+    void *(*alloc)(void *arena, size_t bytes, size_t align);
+    void *arena;
+} csim_policy_config;
+
+/* used by report() to hand back one named statistic */
+typedef void (*csim_report_fn)(void *out, const char *name, double value);
+
+typedef struct csim_policy {
+    uint32_t abi_version; /* CSIM_POLICY_ABI_VERSION */
+    uint32_t line_meta_bytes; /* zero-filled metadata per line */
+    uint32_t set_meta_bytes; /* zero-filled metadata per set */
+    const char *name;
+
+    /* returns the policy context passed to every other callback, or NULL on
+     * bad args. may be NULL if the policy keeps no state of its own */
+    void *(*create)(const csim_policy_config *config);
+    /* optional, for anything create() got outside of config->alloc */
+    void (*destroy)(void *ctx);
+
+    /* optional, called once per set before the run */
+    void (*init_set)(void *ctx, uint32_t set, uint8_t *set_meta, uint8_t *line_meta);
+
+    /* a line was hit */
+    void (*on_hit)(void *ctx, const csim_access *access, uint8_t *set_meta,
+                   uint8_t *line_meta, uint32_t way);
+
+    /* a block was just placed in the given way */
+    void (*on_fill)(void *ctx, const csim_access *access, uint8_t *set_meta,
+                    uint8_t *line_meta, uint32_t way);
+
+    /* a block has to be placed in the set. first_invalid is the lowest empty
+     * way, or ways if the set is full. returns the way to (re)fill, or
+     * CSIM_POLICY_BYPASS to not cache the block at all */
+    uint32_t (*choose_victim)(void *ctx, const csim_access *access, uint8_t *set_meta,
+                              uint8_t *line_meta, uint32_t first_invalid);
+
+    /* optional batched version of on_hit. when present the engine queues hits
+     * and delivers them in order, always before the next choose_victim,
+     * on_fill or on_bypass call, so a policy never sees stale metadata */
+    void (*on_hit_batch)(void *ctx, const csim_hit *hits, size_t count);
+
+    /* optional, extra statistics printed after the summary */
+    void (*report)(void *ctx, csim_report_fn emit, void *out);
+
+    /* optional (ABI 2), a miss whose block is not placed in the cache at all,
+     * such as a store miss under no-write-allocate. choose_victim is not
+     * called for these, so a policy that learns from every access of a set
+     * hears about them here */
+    void (*on_bypass)(void *ctx, const csim_access *access, uint8_t *set_meta,
+                      uint8_t *line_meta);
+} csim_policy;
+
+/* the symbol a plugin exports under the name CSIM_POLICY_ENTRY */
+typedef const csim_policy *(*csim_policy_entry_fn)(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
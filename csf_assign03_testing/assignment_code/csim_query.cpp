@@ -0,0 +1,500 @@
+// csim-query: filters, groups and sorts the results files that sweeps write
+// with --results (see results.h). the files are mapped and every filter is
+// one tight loop over a column, straight from the mapping
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "options.h"
+#include "results.h"
+
+using namespace std;
+
+namespace {
+
+enum class Op : uint8_t { LT, LE, EQ, NE, GE, GT };
+
+struct Condition {
+    string column;
+    Op op;
+    string value;
+};
+
+// columns computed from the stored ones
+const char *const DERIVED[] = {"capacity", "accesses", "misses", "miss_rate"};
+
+bool isDerived(const string &name) {
+    return find(begin(DERIVED), end(DERIVED), name) != end(DERIVED);
+}
+
+vector<string> splitList(const string &text) {
+    vector<string> parts;
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t comma = text.find(',', start);
+        if (comma == string::npos) {
+            comma = text.size();
+        }
+        parts.push_back(text.substr(start, comma - start));
+        start = comma + 1;
+    }
+    return parts;
+}
+
+bool parseCondition(const string &text, Condition &cond) {
+    // two-character operators first so "<=" is not read as "<"
+    static const pair<const char *, Op> ops[] = {{"<=", Op::LE}, {">=", Op::GE}, {"!=", Op::NE},
+                                                 {"<", Op::LT},  {">", Op::GT},  {"=", Op::EQ}};
+    for (const auto &op : ops) {
+        size_t at = text.find(op.first);
+        if (at != string::npos && at > 0) {
+            cond.column = text.substr(0, at);
+            cond.op = op.second;
+            cond.value = text.substr(at + strlen(op.first));
+            return !cond.value.empty();
+        }
+    }
+    return false;
+}
+
+// keep[i] &= decode(data[i]) op value, one loop per operator so the compiler
+// can vectorize each
+template <typename T, typename Decode>
+void filterColumn(const T *data, size_t n, Op op, double value, uint8_t *keep, Decode decode) {
+    switch (op) {
+    case Op::LT:
+        for (size_t i = 0; i < n; i++) {
+            keep[i] &= decode(data[i]) < value;
+        }
+        break;
+    case Op::LE:
+        for (size_t i = 0; i < n; i++) {
+            keep[i] &= decode(data[i]) <= value;
+        }
+        break;
+    case Op::EQ:
+        for (size_t i = 0; i < n; i++) {
+            keep[i] &= decode(data[i]) == value;
+        }
+        break;
+    case Op::NE:
+        for (size_t i = 0; i < n; i++) {
+            keep[i] &= decode(data[i]) != value;
+        }
+        break;
+    case Op::GE:
+        for (size_t i = 0; i < n; i++) {
+            keep[i] &= decode(data[i]) >= value;
+        }
+        break;
+    case Op::GT:
+        for (size_t i = 0; i < n; i++) {
+            keep[i] &= decode(data[i]) > value;
+        }
+        break;
+    }
+}
+
+// a column the query names, resolved against every input file once so the
+// per-row work is an array read: stored columns by pointer, derived ones
+// through the stored columns they come from, and dictionary columns through
+// a code -> rank table that orders the names of all the files together, so
+// text sorts and groups as plain numbers
+class ColumnReader {
+public:
+    ColumnReader(const vector<unique_ptr<ResultsFile>> &files, const string &name);
+
+    bool text() const { return kind == Kind::TEXT; }
+
+    // what rows sort and pick the best by: the number, or the rank of a name
+    double value(size_t file, size_t row) const {
+        const Sources &s = sources[file];
+        switch (kind) {
+        case Kind::STORED:
+            return (double) s.stored->at(row);
+        case Kind::TEXT:
+            return ranks[file][s.stored->at(row)];
+        case Kind::CAPACITY:
+            return (double) s.sets->at(row) * s.ways->at(row) * s.block->at(row);
+        case Kind::ACCESSES:
+            return (double) s.loads->at(row) + s.stores->at(row);
+        case Kind::MISSES:
+            return (double) s.loadMisses->at(row) + s.storeMisses->at(row);
+        default: {
+            double accesses = (double) s.loads->at(row) + s.stores->at(row);
+            double misses = (double) s.loadMisses->at(row) + s.storeMisses->at(row);
+            return accesses != 0 ? misses / accesses : 0;
+        }
+        }
+    }
+
+    // the same as an integer that is equal exactly when the printed cells are
+    uint64_t groupKey(size_t file, size_t row) const {
+        if (kind == Kind::STORED) {
+            return sources[file].stored->at(row);
+        }
+        if (kind == Kind::MISS_RATE) {
+            return (uint64_t) llround(value(file, row) * 10000);
+        }
+        return (uint64_t) value(file, row);
+    }
+
+    // the column as text, the way it is printed
+    string cell(size_t file, size_t row) const;
+
+private:
+    enum class Kind : uint8_t { STORED, TEXT, CAPACITY, ACCESSES, MISSES, MISS_RATE };
+
+    struct Sources {
+        const ResultColumn *stored = nullptr;
+        const ResultColumn *sets, *ways, *block, *loads, *stores, *loadMisses, *storeMisses;
+    };
+
+    Kind kind = Kind::STORED;
+    vector<Sources> sources; // per file
+    vector<vector<uint32_t>> ranks; // per file, by code, TEXT only
+};
+
+ColumnReader::ColumnReader(const vector<unique_ptr<ResultsFile>> &files, const string &name) {
+    static const pair<const char *, Kind> derived[] = {{"capacity", Kind::CAPACITY},
+                                                       {"accesses", Kind::ACCESSES},
+                                                       {"misses", Kind::MISSES},
+                                                       {"miss_rate", Kind::MISS_RATE}};
+    bool isStored = true;
+    for (const auto &d : derived) {
+        if (name == d.first) {
+            kind = d.second;
+            isStored = false;
+        }
+    }
+    for (const unique_ptr<ResultsFile> &file : files) {
+        Sources s;
+        if (isStored) {
+            s.stored = file->column(name);
+        }
+        s.sets = file->column("sets");
+        s.ways = file->column("ways");
+        s.block = file->column("block");
+        s.loads = file->column("loads");
+        s.stores = file->column("stores");
+        s.loadMisses = file->column("load_misses");
+        s.storeMisses = file->column("store_misses");
+        sources.push_back(s);
+    }
+    if (!isStored || sources.empty() || sources[0].stored->encoding != ColumnEncoding::DICT) {
+        return;
+    }
+
+    // every file has its own dictionary, rank the names of all of them
+    kind = Kind::TEXT;
+    vector<string> names;
+    for (const Sources &s : sources) {
+        names.insert(names.end(), s.stored->dict.begin(), s.stored->dict.end());
+    }
+    sort(names.begin(), names.end());
+    names.erase(unique(names.begin(), names.end()), names.end());
+    for (const Sources &s : sources) {
+        // codes past the dictionary are possible in a damaged file, they
+        // rank after every name
+        vector<uint32_t> rank(UINT16_MAX + 1, (uint32_t) names.size());
+        for (size_t code = 0; code < s.stored->dict.size(); code++) {
+            rank[code] = lower_bound(names.begin(), names.end(), s.stored->dict[code]) - names.begin();
+        }
+        ranks.push_back(move(rank));
+    }
+}
+
+string ColumnReader::cell(size_t file, size_t row) const {
+    if (kind == Kind::TEXT) {
+        const ResultColumn *col = sources[file].stored;
+        uint64_t code = col->at(row);
+        return code < col->dict.size() ? col->dict[code] : "?";
+    }
+    double v = value(file, row);
+    ostringstream out;
+    if (kind == Kind::MISS_RATE) {
+        out << fixed << setprecision(4) << v;
+    } else {
+        out << (unsigned long long) v;
+    }
+    return out.str();
+}
+
+// clear keep[i] for the rows that fail the condition
+bool applyCondition(const ResultsFile &file, size_t index, const map<string, ColumnReader> &readers,
+                    const Condition &cond, vector<uint8_t> &keep, string &error) {
+    size_t n = file.rows();
+    if (isDerived(cond.column)) {
+        // materialize the derived column once, then scan it like a stored one
+        const ColumnReader &reader = readers.at(cond.column);
+        vector<double> values(n);
+        for (size_t i = 0; i < n; i++) {
+            values[i] = reader.value(index, i);
+        }
+        char *end;
+        double v = strtod(cond.value.c_str(), &end);
+        if (*end != '\0') {
+            error = "'" + cond.value + "' is not a number";
+            return false;
+        }
+        filterColumn(values.data(), n, cond.op, v, keep.data(), [](double x) { return x; });
+        return true;
+    }
+    const ResultColumn *col = file.column(cond.column);
+    if (col == nullptr) {
+        error = "no column '" + cond.column + "'";
+        return false;
+    }
+    if (col->encoding == ColumnEncoding::DICT) {
+        if (cond.op != Op::EQ && cond.op != Op::NE) {
+            error = "'" + cond.column + "' can only be compared with = or !=";
+            return false;
+        }
+        // a name that is not in the dictionary matches no code
+        auto it = find(col->dict.begin(), col->dict.end(), cond.value);
+        double code = it == col->dict.end() ? -1 : (double) (it - col->dict.begin());
+        filterColumn(reinterpret_cast<const uint16_t *>(col->data), n, cond.op, code, keep.data(),
+                     [](uint16_t x) { return (double) x; });
+        return true;
+    }
+    char *end;
+    double v = strtod(cond.value.c_str(), &end);
+    if (*end != '\0') {
+        error = "'" + cond.value + "' is not a number";
+        return false;
+    }
+    switch (col->encoding) {
+    case ColumnEncoding::LOG2:
+        filterColumn(col->data, n, cond.op, v, keep.data(),
+                     [](uint8_t x) { return (double) (1ull << x); });
+        break;
+    case ColumnEncoding::FLAG:
+        filterColumn(col->data, n, cond.op, v, keep.data(), [](uint8_t x) { return (double) x; });
+        break;
+    case ColumnEncoding::U32:
+        filterColumn(reinterpret_cast<const uint32_t *>(col->data), n, cond.op, v, keep.data(),
+                     [](uint32_t x) { return (double) x; });
+        break;
+    default:
+        filterColumn(reinterpret_cast<const uint64_t *>(col->data), n, cond.op, v, keep.data(),
+                     [](uint64_t x) { return (double) x; });
+    }
+    return true;
+}
+
+struct Selected {
+    size_t file; // index into the inputs
+    size_t row;
+};
+
+struct SortKey {
+    string column;
+    bool desc;
+};
+
+}
+
+int main(int argc, char **argv) {
+    Options opts;
+    string error;
+    unsigned long limit;
+    if (!opts.parse(argc, argv, 1, error) || !opts.getUnsigned("limit", 0, limit, error)) {
+        cerr << "Error: " << error << "\n";
+        return 1;
+    }
+    vector<string> inputs = splitList(opts.get("input", ""));
+    vector<string> where = splitList(opts.get("where", ""));
+    vector<string> group = splitList(opts.get("group", ""));
+    string best = opts.get("best", "cycles");
+    vector<string> sortSpecs = splitList(opts.get("sort", ""));
+    vector<string> shown =
+        splitList(opts.get("columns", "trace,sets,ways,block,alloc,write,policy,miss_rate,cycles"));
+    if (!opts.firstUnused().empty() || inputs.empty() || shown.empty()) {
+        cerr << "Usage: ./csim-query --input=<results>[,<results>...] [--where=<col><op><value>[,...]] "
+                "[--group=<col>[,<col>...]] [--best=<col>[:max]] [--sort=<col>[:desc][,...]] [--limit=N] "
+                "[--columns=<col>[,<col>...]]\n";
+        return 1;
+    }
+    bool bestMax = best.size() > 4 && best.compare(best.size() - 4, 4, ":max") == 0;
+    if (bestMax) {
+        best.resize(best.size() - 4);
+    }
+    vector<SortKey> sortKeys;
+    for (string spec : sortSpecs) {
+        bool desc = spec.size() > 5 && spec.compare(spec.size() - 5, 5, ":desc") == 0;
+        if (desc) {
+            spec.resize(spec.size() - 5);
+        }
+        sortKeys.push_back(SortKey{spec, desc});
+    }
+    vector<Condition> conditions;
+    for (const string &text : where) {
+        Condition cond;
+        if (!parseCondition(text, cond)) {
+            cerr << "Error: bad condition '" << text << "'\n";
+            return 1;
+        }
+        conditions.push_back(cond);
+    }
+
+    vector<unique_ptr<ResultsFile>> files;
+    for (const string &name : inputs) {
+        files.emplace_back(new ResultsFile);
+        if (!files.back()->open(name, error)) {
+            cerr << "Error: " << error << "\n";
+            return 1;
+        }
+    }
+    // every column the query names has to exist in every file, and the
+    // derived ones are computed from these
+    vector<string> named = {"sets", "ways", "block", "loads", "stores", "load_misses", "store_misses"};
+    named.insert(named.end(), shown.begin(), shown.end());
+    named.insert(named.end(), group.begin(), group.end());
+    named.push_back(best);
+    for (const SortKey &key : sortKeys) {
+        named.push_back(key.column);
+    }
+    for (const unique_ptr<ResultsFile> &file : files) {
+        for (const string &name : named) {
+            if (!isDerived(name) && file->column(name) == nullptr) {
+                cerr << "Error: no column '" << name << "'\n";
+                return 1;
+            }
+        }
+    }
+    // resolved once here, so the loops below never look a column up by name
+    for (const Condition &cond : conditions) {
+        if (isDerived(cond.column)) {
+            named.push_back(cond.column);
+        }
+    }
+    map<string, ColumnReader> readers;
+    for (const string &name : named) {
+        readers.try_emplace(name, files, name);
+    }
+
+    vector<Selected> rows;
+    unsigned long scanned = 0;
+    for (size_t f = 0; f < files.size(); f++) {
+        vector<uint8_t> keep(files[f]->rows(), 1);
+        for (const Condition &cond : conditions) {
+            if (!applyCondition(*files[f], f, readers, cond, keep, error)) {
+                cerr << "Error: " << error << "\n";
+                return 1;
+            }
+        }
+        for (size_t i = 0; i < keep.size(); i++) {
+            if (keep[i]) {
+                rows.push_back(Selected{f, i});
+            }
+        }
+        scanned += files[f]->rows();
+    }
+
+    // one row per group, the one with the lowest (or highest) best column
+    if (!group.empty()) {
+        vector<const ColumnReader *> groupReaders;
+        for (const string &name : group) {
+            groupReaders.push_back(&readers.at(name));
+        }
+        const ColumnReader &bestReader = readers.at(best);
+        // keys are integers that are equal exactly when the printed cells
+        // are, and text ones are ranks, so the map is in key order too
+        map<vector<uint64_t>, Selected> bests;
+        vector<uint64_t> key(group.size());
+        for (const Selected &s : rows) {
+            for (size_t k = 0; k < groupReaders.size(); k++) {
+                key[k] = groupReaders[k]->groupKey(s.file, s.row);
+            }
+            auto [it, added] = bests.try_emplace(key, s);
+            if (added) {
+                continue;
+            }
+            double v = bestReader.value(s.file, s.row);
+            double current = bestReader.value(it->second.file, it->second.row);
+            if (bestMax ? v > current : v < current) {
+                it->second = s;
+            }
+        }
+        rows.clear();
+        for (const auto &entry : bests) {
+            rows.push_back(entry.second);
+        }
+        // groups come out in key order unless --sort says otherwise
+        if (sortKeys.empty()) {
+            for (const string &name : group) {
+                sortKeys.push_back(SortKey{name, false});
+            }
+        }
+    }
+
+    if (!sortKeys.empty()) {
+        // every row's keys read out once, then the sort only compares doubles
+        size_t width = sortKeys.size();
+        vector<double> values(rows.size() * width);
+        for (size_t k = 0; k < width; k++) {
+            const ColumnReader &reader = readers.at(sortKeys[k].column);
+            for (size_t r = 0; r < rows.size(); r++) {
+                values[r * width + k] = reader.value(rows[r].file, rows[r].row);
+            }
+        }
+        vector<size_t> order(rows.size());
+        for (size_t r = 0; r < order.size(); r++) {
+            order[r] = r;
+        }
+        stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            for (size_t k = 0; k < width; k++) {
+                double x = values[a * width + k], y = values[b * width + k];
+                if (x != y) {
+                    return sortKeys[k].desc ? x > y : x < y;
+                }
+            }
+            return false;
+        });
+        vector<Selected> sorted;
+        sorted.reserve(rows.size());
+        for (size_t r : order) {
+            sorted.push_back(rows[r]);
+        }
+        rows.swap(sorted);
+    }
+    if (limit != 0 && rows.size() > limit) {
+        rows.resize(limit);
+    }
+
+    // columns as wide as their widest cell
+    vector<vector<string>> table;
+    table.push_back(shown);
+    vector<const ColumnReader *> shownReaders;
+    for (const string &name : shown) {
+        shownReaders.push_back(&readers.at(name));
+    }
+    for (const Selected &s : rows) {
+        vector<string> line;
+        for (const ColumnReader *reader : shownReaders) {
+            line.push_back(reader->cell(s.file, s.row));
+        }
+        table.push_back(line);
+    }
+    vector<size_t> widths(shown.size(), 0);
+    for (const vector<string> &line : table) {
+        for (size_t c = 0; c < line.size(); c++) {
+            widths[c] = max(widths[c], line[c].size());
+        }
+    }
+    for (const vector<string> &line : table) {
+        for (size_t c = 0; c < line.size(); c++) {
+            cout << left << setw(c + 1 == line.size() ? 0 : widths[c] + 2) << line[c];
+        }
+        cout << "\n";
+    }
+    cerr << "csim-query: " << scanned << " rows scanned, " << rows.size() << " shown\n";
+    return 0;
+}
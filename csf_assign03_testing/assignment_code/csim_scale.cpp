@@ -0,0 +1,322 @@
+// csim-scale: thread scaling of csim's parallel modes. every mode runs at 1,
+// 2, 4, ... up to --threads threads, strong (the same work split over more
+// threads) and weak (work growing with the threads), over the bundled traces
+// and a synthetic one made of --scale disjoint copies of the first. it reports
+// speedup and efficiency against the one-thread run along with the pool's
+// per-worker idle time and lock contention, as a text table and, with
+// --json, as a JSON file
+//   sweep       runSweep over a set of configs, tiles
+//   coroutines  the same with every config a coroutine
+//   aslr        runLayouts over randomized layouts
+//   reuse       reuseDistances with one chunk per thread
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "cache.h"
+#include "layout.h"
+#include "options.h"
+#include "policy.h"
+#include "reuse.h"
+#include "sweep.h"
+#include "thread_pool.h"
+#include "trace.h"
+
+using namespace std;
+
+namespace {
+
+// work units per run: configs for sweeps, layouts for aslr. strong runs
+// split STRONG_UNITS, weak runs give every thread WEAK_UNITS
+const unsigned STRONG_UNITS = 32;
+const unsigned WEAK_UNITS = 4;
+// copies are laid out a page at a time, the 32-bit space holds this many
+const unsigned PAGE_BITS = 12;
+const unsigned long MAX_PAGES = 1ul << (32 - PAGE_BITS);
+
+struct Input {
+    string name;
+    vector<TraceRecord> records;
+};
+
+struct Run {
+    string mode;
+    string trace;
+    bool weak;
+    unsigned threads;
+    double seconds;
+    double speedup; // weak runs: the work done per second against one thread
+    double efficiency;
+    ThreadPool::Stats pool;
+};
+
+vector<string> split(const string &list) {
+    vector<string> parts;
+    stringstream in(list);
+    string part;
+    while (getline(in, part, ',')) {
+        if (!part.empty()) {
+            parts.push_back(part);
+        }
+    }
+    return parts;
+}
+
+// the distinct pages a trace touches, in address order
+vector<uint32_t> tracePages(const vector<TraceRecord> &records) {
+    vector<uint32_t> pages;
+    pages.reserve(records.size());
+    for (const TraceRecord &rec : records) {
+        pages.push_back(rec.addr >> PAGE_BITS);
+    }
+    sort(pages.begin(), pages.end());
+    pages.erase(unique(pages.begin(), pages.end()), pages.end());
+    return pages;
+}
+
+// the trace again and again. every copy's pages are packed, in order, into
+// a range of their own, so no two copies share a line however the trace is
+// spread over the address space. copies * pages must fit in MAX_PAGES
+vector<TraceRecord> scaledTrace(const vector<TraceRecord> &records, unsigned copies) {
+    vector<uint32_t> pages = tracePages(records);
+    vector<uint32_t> index(records.size());
+    for (size_t i = 0; i < records.size(); i++) {
+        uint32_t page = records[i].addr >> PAGE_BITS;
+        index[i] = lower_bound(pages.begin(), pages.end(), page) - pages.begin();
+    }
+    vector<TraceRecord> scaled;
+    scaled.reserve(records.size() * copies);
+    for (unsigned c = 0; c < copies; c++) {
+        uint32_t base = c * pages.size();
+        for (size_t i = 0; i < records.size(); i++) {
+            TraceRecord rec = records[i];
+            uint32_t offset = rec.addr & ((1u << PAGE_BITS) - 1);
+            rec.addr = ((base + index[i]) << PAGE_BITS) | offset;
+            scaled.push_back(rec);
+        }
+    }
+    return scaled;
+}
+
+// a spread of geometries and both built-in policies, units of them
+vector<CacheConfig> sweepConfigs(unsigned units) {
+    const unsigned sets[] = {256, 1024, 4096};
+    const unsigned ways[] = {1, 4, 8, 16};
+    const unsigned blocks[] = {16, 64};
+    const char *policies[] = {"lru", "fifo"};
+    vector<CacheConfig> configs;
+    for (unsigned i = 0; i < units; i++) {
+        CacheConfig c;
+        c.numSets = sets[i % 3];
+        c.blocksPerSet = ways[i / 3 % 4];
+        c.blockSize = blocks[i / 12 % 2];
+        c.writeAllocate = true;
+        c.writeBack = i % 2 == 0;
+        c.policy = findBuiltinPolicy(policies[i / 24 % 2]);
+        configs.push_back(c);
+    }
+    return configs;
+}
+
+// one timed run of a mode, filling in run.seconds and run.pool
+void runMode(const string &mode, const vector<TraceRecord> &records, unsigned units, Pinning pin,
+             Run &run) {
+    auto start = chrono::steady_clock::now();
+    if (mode == "sweep" || mode == "coroutines") {
+        vector<SweepRow> rows;
+        SweepTiming timing = runSweep(sweepConfigs(units), records, run.threads,
+                                      mode == "sweep" ? SweepExecutor::TILES : SweepExecutor::COROUTINES,
+                                      rows, pin);
+        run.pool = timing.pool;
+    } else if (mode == "aslr") {
+        CacheConfig cache = sweepConfigs(1)[0];
+        LayoutConfig config;
+        config.count = units;
+        config.threads = run.threads;
+        config.pin = pin;
+        run.pool = runLayouts(cache, records, config).pool;
+    } else {
+        ReuseConfig config;
+        config.blockSize = 64;
+        config.threads = run.threads;
+        config.pin = pin;
+        run.pool = reuseDistances(records, config).pool;
+    }
+    run.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+void printTable(const vector<Run> &runs, ostream &out) {
+    out << left << setw(12) << "mode" << setw(16) << "trace" << setw(8) << "scaling" << right
+        << setw(8) << "threads" << setw(10) << "seconds" << setw(9) << "speedup" << setw(11)
+        << "efficiency" << setw(10) << "idle s" << setw(12) << "max idle s" << setw(11)
+        << "contended" << "\n";
+    for (const Run &r : runs) {
+        double maxIdle = 0;
+        for (double idle : r.pool.workerIdleSeconds) {
+            maxIdle = max(maxIdle, idle);
+        }
+        out << left << setw(12) << r.mode << setw(16) << r.trace << setw(8)
+            << (r.weak ? "weak" : "strong") << right << setw(8) << r.threads << fixed
+            << setprecision(3) << setw(10) << r.seconds << setprecision(2) << setw(9) << r.speedup
+            << setw(11) << r.efficiency << setprecision(3) << setw(10) << r.pool.idleSeconds
+            << setw(12) << maxIdle << setw(11) << r.pool.contended << defaultfloat
+            << setprecision(6) << "\n";
+    }
+}
+
+string jsonString(const string &s) {
+    string out = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+        }
+        out += c;
+    }
+    return out + "\"";
+}
+
+void writeJson(const vector<Run> &runs, const string &pin, ostream &out) {
+    out << "{\n  \"pin\": " << jsonString(pin) << ",\n  \"runs\": [";
+    for (size_t i = 0; i < runs.size(); i++) {
+        const Run &r = runs[i];
+        out << (i ? "," : "") << "\n    {\"mode\": " << jsonString(r.mode)
+            << ", \"trace\": " << jsonString(r.trace) << ", \"scaling\": \""
+            << (r.weak ? "weak" : "strong") << "\", \"threads\": " << r.threads
+            << ", \"seconds\": " << r.seconds << ", \"speedup\": " << r.speedup
+            << ", \"efficiency\": " << r.efficiency << ", \"idle_seconds\": " << r.pool.idleSeconds
+            << ", \"worker_idle_seconds\": [";
+        for (size_t w = 0; w < r.pool.workerIdleSeconds.size(); w++) {
+            out << (w ? ", " : "") << r.pool.workerIdleSeconds[w];
+        }
+        out << "], \"contended\": " << r.pool.contended << ", \"tasks\": " << r.pool.tasks << "}";
+    }
+    out << "\n  ]\n}\n";
+}
+
+}
+
+int main(int argc, char **argv) {
+    Options opts;
+    string error;
+    unsigned long maxThreads, scale;
+    if (!opts.parse(argc, argv, 1, error) ||
+        !opts.getUnsigned("threads", thread::hardware_concurrency(), maxThreads, error) ||
+        !opts.getUnsigned("scale", 4, scale, error)) {
+        cerr << "Error: " << error << "\n";
+        return 1;
+    }
+    vector<string> modes = split(opts.get("modes", "sweep,coroutines,aslr,reuse"));
+    vector<string> traces = split(opts.get("traces", "gcc"));
+    string traceDir = opts.get("trace-dir", "../traces");
+    string pinName = opts.get("pin", "none");
+    string jsonFile = opts.get("json", "");
+    if (!opts.firstUnused().empty() || traces.empty()) {
+        cerr << "Usage: ./csim-scale [--threads=<cores>] [--modes=sweep,coroutines,aslr,reuse] "
+                "[--traces=gcc] [--trace-dir=../traces] [--scale=4] [--pin=none|compact|spread] "
+                "[--json=FILE]\n";
+        return 1;
+    }
+    Pinning pin = Pinning::NONE;
+    if (pinName == "compact") {
+        pin = Pinning::COMPACT;
+    } else if (pinName == "spread") {
+        pin = Pinning::SPREAD;
+    } else if (pinName != "none") {
+        cerr << "Error: --pin must be none, compact or spread.\n";
+        return 1;
+    }
+    for (const string &mode : modes) {
+        if (mode != "sweep" && mode != "coroutines" && mode != "aslr" && mode != "reuse") {
+            cerr << "Error: unknown mode " << mode << ".\n";
+            return 1;
+        }
+    }
+    maxThreads = max(maxThreads, 1ul);
+
+    vector<Input> inputs;
+    for (const string &name : traces) {
+        string path = traceDir + "/" + name + ".trace";
+        Input input{name, {}};
+        error = "could not open it";
+        FILE *in = fopen(path.c_str(), "rb");
+        bool ok = in != nullptr && readTrace(in, input.records, error);
+        if (in != nullptr) {
+            fclose(in);
+        }
+        if (!ok) {
+            cerr << "Error: " << path << ": " << error << "\n";
+            return 1;
+        }
+        inputs.push_back(move(input));
+    }
+    // weak reuse runs make a copy of every trace, the scaled one too, per
+    // thread. all the copies have to fit in the address space
+    bool reuse = find(modes.begin(), modes.end(), "reuse") != modes.end();
+    unsigned long copies = reuse ? maxThreads : 1;
+    for (size_t i = 0; i < inputs.size(); i++) {
+        unsigned long times = i == 0 ? max(scale, 1ul) : 1;
+        if (tracePages(inputs[i].records).size() > MAX_PAGES / times / copies) {
+            cerr << "Error: --scale and --threads make too many copies of " << inputs[i].name
+                 << " for the 32-bit address space.\n";
+            return 1;
+        }
+    }
+    if (scale > 1) {
+        inputs.push_back(Input{inputs[0].name + "x" + to_string(scale),
+                               scaledTrace(inputs[0].records, scale)});
+    }
+
+    vector<unsigned> counts;
+    for (unsigned t = 1; t < maxThreads; t *= 2) {
+        counts.push_back(t);
+    }
+    counts.push_back(maxThreads);
+
+    // reuse has no units of work to hand out, its weak runs repeat the trace
+    // once per thread instead
+    vector<Run> runs;
+    try {
+        for (const string &mode : modes) {
+            for (const Input &input : inputs) {
+                for (bool weak : {false, true}) {
+                    double base = 0;
+                    for (unsigned threads : counts) {
+                        Run run{mode, input.name, weak, threads, 0, 0, 0, {}};
+                        unsigned units = weak ? WEAK_UNITS * threads : STRONG_UNITS;
+                        if (mode == "reuse" && weak) {
+                            runMode(mode, scaledTrace(input.records, threads), units, pin, run);
+                        } else {
+                            runMode(mode, input.records, units, pin, run);
+                        }
+                        if (threads == 1) {
+                            base = run.seconds;
+                        }
+                        run.speedup = base / run.seconds * (weak ? threads : 1);
+                        run.efficiency = run.speedup / threads;
+                        runs.push_back(run);
+                    }
+                }
+            }
+        }
+    } catch (const exception &e) {
+        cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+
+    printTable(runs, cout);
+    if (!jsonFile.empty()) {
+        ofstream out(jsonFile);
+        writeJson(runs, pinName, out);
+        if (!out) {
+            cerr << "Error: could not write " << jsonFile << "\n";
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,119 @@
+// csim-share: false sharing analysis over several traces, one per thread.
+// the traces are interleaved by time (each thread's running sum of gaps)
+// and fed to a SharingDetector (sharing.h)
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "options.h"
+#include "sharing.h"
+#include "trace.h"
+
+using namespace std;
+
+int main(int argc, char **argv) {
+    Options opts;
+    string error;
+    unsigned long blockSize, accessSize, window, top;
+    if (!opts.parse(argc, argv, 1, error) || !opts.getUnsigned("block", 64, blockSize, error) ||
+        !opts.getUnsigned("access-size", 4, accessSize, error) ||
+        !opts.getUnsigned("window", 10000, window, error) ||
+        !opts.getUnsigned("top", 10, top, error)) {
+        cerr << "Error: " << error << "\n";
+        return 1;
+    }
+    string list = opts.get("input", "");
+    if (!opts.firstUnused().empty() || list.empty()) {
+        cerr << "Usage: ./csim-share --input=<thread0.trace>,<thread1.trace>[,...] [--block=64] "
+                "[--access-size=4] [--window=10000] [--top=10]\n";
+        return 1;
+    }
+    if (blockSize < 4 || blockSize > 64 || (blockSize & (blockSize - 1)) != 0 || accessSize < 1 ||
+        accessSize > blockSize || window < 1) {
+        cerr << "Error: --block must be a power of two from 4 to 64, --access-size at most a block "
+                "and --window at least 1.\n";
+        return 1;
+    }
+
+    vector<string> names;
+    size_t start = 0;
+    while (start < list.size()) {
+        size_t comma = list.find(',', start);
+        if (comma == string::npos) {
+            comma = list.size();
+        }
+        names.push_back(list.substr(start, comma - start));
+        start = comma + 1;
+    }
+    if (names.size() > SharingDetector::MAX_THREADS) {
+        cerr << "Error: at most " << SharingDetector::MAX_THREADS << " threads.\n";
+        return 1;
+    }
+    vector<vector<TraceRecord>> threads(names.size());
+    for (size_t t = 0; t < names.size(); t++) {
+        error = "could not open it";
+        FILE *in = fopen(names[t].c_str(), "rb");
+        bool ok = in != nullptr && readTrace(in, threads[t], error);
+        if (in != nullptr) {
+            fclose(in);
+        }
+        if (!ok) {
+            cerr << "Error: " << names[t] << ": " << error << "\n";
+            return 1;
+        }
+    }
+
+    SharingConfig config;
+    config.blockSize = blockSize;
+    config.accessSize = accessSize;
+    config.window = window;
+    SharingDetector detector(config);
+
+    // the thread whose next access comes first goes next, ties to the lower thread
+    vector<size_t> pos(threads.size(), 0);
+    vector<uint64_t> time(threads.size(), 0);
+    while (true) {
+        size_t next = threads.size();
+        uint64_t nextTime = 0;
+        for (size_t t = 0; t < threads.size(); t++) {
+            if (pos[t] < threads[t].size()) {
+                uint64_t at = time[t] + threads[t][pos[t]].gap;
+                if (next == threads.size() || at < nextTime) {
+                    next = t;
+                    nextTime = at;
+                }
+            }
+        }
+        if (next == threads.size()) {
+            break;
+        }
+        time[next] = nextTime;
+        detector.access((unsigned) next, threads[next][pos[next]++]);
+    }
+
+    unsigned long coherence = detector.falseMisses() + detector.trueMisses();
+    cout << "Threads: " << threads.size() << "\n";
+    cout << "Accesses: " << detector.accesses() << "\n";
+    cout << "Blocks written by several threads: " << detector.sharedWrittenBlocks() << "\n";
+    cout << "Disjoint writes: " << detector.disjointWrites() << "\n";
+    cout << "Coherence misses: " << coherence << "\n";
+    cout << "True sharing misses: " << detector.trueMisses() << "\n";
+    cout << "False sharing misses: " << detector.falseMisses() << "\n";
+    cout << "False sharing share: " << (coherence ? (double) detector.falseMisses() / coherence : 0.0)
+         << "\n";
+
+    vector<SharedBlock> worst = detector.top(top);
+    if (!worst.empty()) {
+        cout << "Top blocks:\n";
+        cout << "  address     threads  writers  accesses  disjoint  false  true\n";
+        for (const SharedBlock &b : worst) {
+            cout << "  0x" << hex << setw(8) << setfill('0') << ((uint64_t) b.block * blockSize)
+                 << "  0x" << setw(4) << b.threads << "   0x" << setw(4) << b.writers << dec
+                 << setfill(' ') << "   " << setw(8) << b.accesses << "  " << setw(8)
+                 << b.disjointWrites << "  " << setw(5) << b.falseMisses << "  " << b.trueMisses
+                 << "\n";
+        }
+    }
+    return 0;
+}
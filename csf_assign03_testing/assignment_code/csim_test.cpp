@@ -0,0 +1,649 @@
+// golden-result test driver: loads every trace once, runs each (config,
+// policy) case on its own engine across a thread pool, and compares the
+// summary against expected_results/<trace>/<sets>_<ways>_<block>_<wa|nwa>_<wt|wb>_<policy>.txt.
+// a golden named with a last _<opt>+<opt>... part, or with a plugin (.so)
+// policy, is run through ./csim with --<opt> for each opt instead, and
+// compared against csim's whole output. the cases are the configs
+// run_tests.sh knows plus every golden file found on disk. --generate writes
+// what the engine under test says for a missing golden to <golden>.new, which
+// only becomes a golden once someone has checked it and renamed it, and the
+// case fails until then. next to the goldens it checks
+// properties that no single golden pins down, some of them through the
+// other tools, so it runs from the directory they are built in
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "cache.h"
+#include "options.h"
+#include "policy.h"
+#include "sweep.h"
+#include "thread_pool.h"
+#include "trace.h"
+
+using namespace std;
+namespace fs = std::filesystem;
+
+namespace {
+
+// one golden comparison
+struct TestCase {
+    string trace;
+    unsigned sets;
+    unsigned ways;
+    unsigned block;
+    bool writeAllocate;
+    bool writeBack;
+    string policy;
+    vector<string> options; // csim options without their --
+    // filled in by the run
+    bool passed = false;
+    bool generated = false;
+    string message;
+};
+
+struct Geometry {
+    const char *trace;
+    unsigned sets, ways, block;
+    bool writeAllocate, writeBack;
+};
+
+// the same configs as run_tests.sh
+const Geometry DEFAULT_CONFIGS[] = {
+    {"write01", 1, 1, 4, true, false},
+    {"write02", 1, 1024, 128, false, false},
+    {"read01", 8192, 1, 16, true, true},
+    {"gcc", 2048, 4, 16, false, false},
+    {"read02", 256, 4, 128, true, false},
+};
+
+string goldenName(const TestCase &c) {
+    string name = to_string(c.sets) + "_" + to_string(c.ways) + "_" + to_string(c.block) + "_" +
+                  (c.writeAllocate ? "wa" : "nwa") + "_" + (c.writeBack ? "wb" : "wt") + "_" +
+                  c.policy;
+    for (size_t i = 0; i < c.options.size(); i++) {
+        name += (i == 0 ? "_" : "+") + c.options[i];
+    }
+    return name;
+}
+
+vector<string> split(const string &text, char separator) {
+    vector<string> parts;
+    stringstream in(text);
+    string part;
+    while (getline(in, part, separator)) {
+        parts.push_back(part);
+    }
+    return parts;
+}
+
+// the reverse of goldenName, false if the file name does not follow it
+bool parseGoldenName(const string &trace, const string &name, TestCase &c) {
+    vector<string> parts = split(name, '_');
+    if ((parts.size() != 6 && parts.size() != 7) || (parts[3] != "wa" && parts[3] != "nwa") ||
+        (parts[4] != "wt" && parts[4] != "wb")) {
+        return false;
+    }
+    char *end;
+    unsigned long values[3];
+    for (int i = 0; i < 3; i++) {
+        values[i] = strtoul(parts[i].c_str(), &end, 10);
+        if (parts[i].empty() || *end != '\0') {
+            return false;
+        }
+    }
+    c.trace = trace;
+    c.sets = values[0];
+    c.ways = values[1];
+    c.block = values[2];
+    c.writeAllocate = parts[3] == "wa";
+    c.writeBack = parts[4] == "wb";
+    c.policy = parts[5];
+    if (parts.size() == 7) {
+        c.options = split(parts[6], '+');
+    }
+    return true;
+}
+
+bool isPlugin(const string &policy) {
+    return policy.size() > 3 && policy.compare(policy.size() - 3, 3, ".so") == 0;
+}
+
+// run a shell command, false if it could not be started or did not exit 0
+bool runTool(const string &command, string &output) {
+    FILE *pipe = popen(command.c_str(), "r");
+    if (pipe == nullptr) {
+        return false;
+    }
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), pipe)) > 0) {
+        output.append(buf, n);
+    }
+    return pclose(pipe) == 0;
+}
+
+// csim's output without the lines that change from run to run: timings,
+// throughput and the sweep's tile sizes, which follow the machine's L2
+string stableLines(const string &text) {
+    string out;
+    for (const string &line : split(text, '\n')) {
+        if (line.find("seconds") == string::npos && line.find("Records/s") == string::npos &&
+            line.compare(0, 6, "Sweep:") != 0) {
+            out += line + "\n";
+        }
+    }
+    return out;
+}
+
+// csim on one of the bundled traces, false with output holding the reason if
+// it failed
+bool runCsim(const string &args, const fs::path &trace, string &output) {
+    string raw;
+    if (!runTool("./csim " + args + " < " + trace.string() + " 2> /dev/null", raw)) {
+        output = "./csim " + args + " failed";
+        return false;
+    }
+    output = stableLines(raw);
+    return true;
+}
+
+string csimArgs(const TestCase &c) {
+    string args = to_string(c.sets) + " " + to_string(c.ways) + " " + to_string(c.block) +
+                  (c.writeAllocate ? " write-allocate" : " no-write-allocate") +
+                  (c.writeBack ? " write-back " : " write-through ") + c.policy;
+    for (const string &option : c.options) {
+        args += " --" + option;
+    }
+    return args;
+}
+
+vector<string> lines(const string &text) {
+    vector<string> out;
+    stringstream in(text);
+    string line;
+    while (getline(in, line)) {
+        // whitespace does not count, like diff -w
+        string squeezed;
+        for (char ch : line) {
+            if (ch != ' ' && ch != '\t' && ch != '\r') {
+                squeezed += ch;
+            }
+        }
+        out.push_back(squeezed);
+    }
+    return out;
+}
+
+// compare csim output against a golden file. cycles are skipped unless a
+// tolerance (in percent) is given, same as run_tests.sh
+bool compare(const string &expected, const string &actual, double tolerance, string &message) {
+    vector<string> want = lines(expected);
+    vector<string> got = lines(actual);
+    if (want.size() != got.size()) {
+        message = "expected " + to_string(want.size()) + " lines, got " + to_string(got.size());
+        return false;
+    }
+    const string cycles = "Totalcycles:";
+    for (size_t i = 0; i < want.size(); i++) {
+        if (want[i].compare(0, cycles.size(), cycles) == 0 &&
+            got[i].compare(0, cycles.size(), cycles) == 0) {
+            if (tolerance < 0) {
+                continue;
+            }
+            double w = strtod(want[i].c_str() + cycles.size(), nullptr);
+            double g = strtod(got[i].c_str() + cycles.size(), nullptr);
+            if (g < w * (1 - tolerance / 100) || g > w * (1 + tolerance / 100)) {
+                message = "cycles " + to_string((unsigned long) g) + " not within " +
+                          to_string(tolerance) + "% of " + to_string((unsigned long) w);
+                return false;
+            }
+            continue;
+        }
+        if (want[i] != got[i]) {
+            message = "line " + to_string(i + 1) + ": expected '" + want[i] + "', got '" + got[i] + "'";
+            return false;
+        }
+    }
+    return true;
+}
+
+// the summary of one case, run on an engine here, or its whole output
+// through csim when it needs csim's options or a plugin
+bool runEngine(const TestCase &c, const vector<TraceRecord> &records, const fs::path &traceDir,
+               string &output) {
+    if (!c.options.empty() || isPlugin(c.policy)) {
+        return runCsim(csimArgs(c), traceDir / (c.trace + ".trace"), output);
+    }
+    CacheConfig config;
+    config.numSets = c.sets;
+    config.blocksPerSet = c.ways;
+    config.blockSize = c.block;
+    config.writeAllocate = c.writeAllocate;
+    config.writeBack = c.writeBack;
+    config.policy = findBuiltinPolicy(c.policy);
+    if (config.policy == nullptr) {
+        output = "no built-in policy '" + c.policy + "'";
+        return false;
+    }
+
+    ostringstream summary;
+    try {
+        Arena arena;
+        Cache cache(config, arena);
+        for (const TraceRecord &rec : records) {
+            cache.access(rec);
+        }
+        cache.finish();
+        writeSummary(cache.stats(), summary);
+    } catch (const exception &e) {
+        output = e.what();
+        return false;
+    }
+    output = summary.str();
+    return true;
+}
+
+void runCase(TestCase &c, const vector<TraceRecord> &records, const fs::path &goldenDir,
+             const fs::path &traceDir, double tolerance, bool generate) {
+    string actual;
+    if (!runEngine(c, records, traceDir, actual)) {
+        c.message = actual;
+        return;
+    }
+
+    fs::path golden = goldenDir / c.trace / (goldenName(c) + ".txt");
+    ifstream in(golden);
+    if (!in) {
+        c.message = "missing " + golden.string() + " (run with --generate)";
+        if (!generate) {
+            return;
+        }
+        // never trusted on its own word, a person reviews and renames it
+        fs::path candidate = golden;
+        candidate += ".new";
+        fs::create_directories(golden.parent_path());
+        ofstream out(candidate);
+        out << actual;
+        c.generated = bool(out);
+        c.message = out ? "review " + candidate.string() + " and rename it to " +
+                              golden.filename().string()
+                        : "could not write " + candidate.string();
+        return;
+    }
+    stringstream expected;
+    expected << in.rdbuf();
+    c.passed = compare(expected.str(), actual, tolerance, c.message);
+}
+
+// a property checked next to the goldens: run returns an empty string when
+// it holds, otherwise what went wrong
+struct PropertyCheck {
+    const char *name;
+    string (*run)(const fs::path &root);
+};
+
+// text -> binary -> text through csim-trace keeps every record
+string checkTraceRoundTrip(const fs::path &root) {
+    for (const char *name : {"gcc", "read02", "write01"}) {
+        fs::path trace = root / "traces" / (string(name) + ".trace");
+        vector<TraceRecord> original, binary, text;
+        string error = "could not open it";
+        FILE *in = fopen(trace.c_str(), "r");
+        bool ok = in != nullptr && readTrace(in, original, error);
+        if (in != nullptr) {
+            fclose(in);
+        }
+        if (!ok) {
+            return trace.string() + ": " + error;
+        }
+        string toBinary = "./csim-trace --format=binary < " + trace.string() + " 2> /dev/null";
+        string toText = toBinary + " | ./csim-trace --format=text 2> /dev/null";
+        for (auto [command, records] : {pair{toBinary, &binary}, pair{toText, &text}}) {
+            FILE *pipe = popen(command.c_str(), "r");
+            bool read = pipe != nullptr && readTrace(pipe, *records, error);
+            if (pipe == nullptr || pclose(pipe) != 0 || !read) {
+                return command + " failed";
+            }
+        }
+        auto same = [&original](const vector<TraceRecord> &records) {
+            return equal(original.begin(), original.end(), records.begin(), records.end(),
+                         [](const TraceRecord &a, const TraceRecord &b) {
+                             return a.addr == b.addr && a.gap == b.gap && a.isStore == b.isStore;
+                         });
+        };
+        if (!same(binary) || !same(text)) {
+            return string(name) + " changed on the way through csim-trace";
+        }
+    }
+    return "";
+}
+
+// two threads writing their own words of one block only ever false share,
+// writing the same word only ever truly shares
+string checkFalseSharing(const fs::path &) {
+    fs::path dir = fs::temp_directory_path() / ("csim_test_" + to_string(getpid()));
+    fs::create_directories(dir);
+    const char *traces[][2] = {{"thread0", "s 0x1000 1\ns 0x1000 1\n"},
+                               {"thread1", "s 0x1004 1\ns 0x1004 1\n"}};
+    for (const auto &trace : traces) {
+        ofstream(dir / (string(trace[0]) + ".trace")) << trace[1];
+    }
+    string t0 = (dir / "thread0.trace").string(), t1 = (dir / "thread1.trace").string();
+    string disjoint, same;
+    bool ok = runTool("./csim-share --input=" + t0 + "," + t1 + " 2> /dev/null", disjoint) &&
+              runTool("./csim-share --input=" + t0 + "," + t0 + " 2> /dev/null", same);
+    fs::remove_all(dir);
+    if (!ok) {
+        return "./csim-share failed";
+    }
+    if (disjoint.find("True sharing misses: 0\n") == string::npos ||
+        disjoint.find("False sharing misses: 2\n") == string::npos) {
+        return "writes to different words of a block were not counted as false sharing";
+    }
+    if (same.find("True sharing misses: 2\n") == string::npos ||
+        same.find("False sharing misses: 0\n") == string::npos) {
+        return "writes to the same word were not counted as true sharing";
+    }
+    return "";
+}
+
+// sweep tiles shrink as the biggest engine grows, down to a floor they keep
+// once the engine alone fills L2
+string checkTileSizes(const fs::path &) {
+    const size_t l2 = 2 << 20;
+    size_t last = sweepTileRecords(0, l2);
+    for (size_t engine = 64 << 10; engine < l2; engine += 64 << 10) {
+        size_t tile = sweepTileRecords(engine, l2);
+        if (tile >= last) {
+            return "tile of " + to_string(tile) + " records next to a " + to_string(engine) +
+                   " byte engine, " + to_string(last) + " next to a smaller one";
+        }
+        last = tile;
+    }
+    size_t floor = sweepTileRecords(l2, l2);
+    if (floor == 0 || floor > last || sweepTileRecords(4 * l2, l2) != floor) {
+        return "tiles next to engines that fill L2 do not stay at the floor";
+    }
+    return "";
+}
+
+// every engine as a coroutine gives the same table as the tiled walk
+string checkSweepCoroutines(const fs::path &root) {
+    fs::path trace = root / "traces" / "gcc.trace";
+    string tiles, coroutines;
+    if (!runCsim("256 4 16 write-allocate write-back lru --block-sweep=capacity", trace, tiles)) {
+        return tiles;
+    }
+    if (!runCsim("256 4 16 write-allocate write-back lru --block-sweep=capacity --sweep-coroutines",
+                 trace, coroutines)) {
+        return coroutines;
+    }
+    return tiles == coroutines ? "" : "--sweep-coroutines changed the sweep's table";
+}
+
+// csim-query reads back the rows a sweep printed
+string checkResultsQuery(const fs::path &root) {
+    fs::path results = fs::temp_directory_path() / ("csim_test_" + to_string(getpid()) + ".res");
+    string sweep, query;
+    // alloc and write are stored as flags, so they print differently
+    string columns = "sets,ways,block,policy,miss_rate,cycles";
+    bool ok = runCsim("256 4 16 write-allocate write-back lru --block-sweep=sets --results=" +
+                          results.string(),
+                      root / "traces" / "gcc.trace", sweep) &&
+              runTool("./csim-query --input=" + results.string() + " --columns=" + columns +
+                          " 2> /dev/null",
+                      query);
+    fs::remove(results);
+    if (!ok) {
+        return sweep.empty() ? "./csim-query failed" : sweep;
+    }
+    // the sweep's table has more columns, the query only what it was asked
+    vector<string> want, got;
+    for (const string &line : split(sweep, '\n')) {
+        vector<string> cells;
+        stringstream in(line);
+        string cell;
+        while (in >> cell) {
+            cells.push_back(cell);
+        }
+        if (cells.size() == 10 && cells[0] != "Sets") {
+            string row;
+            for (int c : {0, 1, 2, 5, 8, 9}) {
+                row += cells[c] + " ";
+            }
+            want.push_back(row);
+        }
+    }
+    vector<string> rows = split(query, '\n');
+    for (size_t i = 1; i < rows.size(); i++) {
+        stringstream in(rows[i]);
+        string cell, row;
+        while (in >> cell) {
+            row += cell + " ";
+        }
+        got.push_back(row);
+    }
+    if (want.empty()) {
+        return "no sweep rows in csim's output";
+    }
+    return want == got ? "" : "csim-query rows differ from the sweep's table";
+}
+
+// the tag filter only skips tag reads that would have missed anyway, so it
+// must not change the summary
+string checkTagFilter(const fs::path &root) {
+    fs::path trace = root / "traces" / "gcc.trace";
+    string plain, filtered;
+    if (!runCsim("256 64 16 write-allocate write-back lru", trace, plain)) {
+        return plain;
+    }
+    if (!runCsim("256 64 16 write-allocate write-back lru --tag-filter", trace, filtered)) {
+        return filtered;
+    }
+    string summary;
+    for (const string &line : split(filtered, '\n')) {
+        if (line.compare(0, 10, "Tag filter") != 0) {
+            summary += line + "\n";
+        }
+    }
+    return summary == plain ? "" : "--tag-filter changed the summary";
+}
+
+// the histogram comes out the same however the trace is cut into chunks
+string checkReuseChunks(const fs::path &root) {
+    fs::path trace = root / "traces" / "gcc.trace";
+    string histograms[2];
+    const char *chunks[] = {"1", "7"};
+    for (int i = 0; i < 2; i++) {
+        string output;
+        string args = "2048 4 16 write-allocate write-back lru --reuse-distance --reuse-threads=2 "
+                      "--reuse-chunks=";
+        if (!runCsim(args + chunks[i], trace, output)) {
+            return output;
+        }
+        // the bucket counts and the mean, not how the work was split
+        for (const string &line : split(output, '\n')) {
+            bool bucket = line.compare(0, 15, "Reuse distance ") == 0 &&
+                          line.find("chunks") == string::npos &&
+                          line.find("threads") == string::npos &&
+                          line.find("merged") == string::npos;
+            if (bucket) {
+                histograms[i] += line + "\n";
+            }
+        }
+    }
+    if (histograms[0].empty()) {
+        return "no reuse distances in csim's output";
+    }
+    return histograms[0] == histograms[1] ? "" : "1 and 7 chunks give different histograms";
+}
+
+// a trace read out of the shared segment simulates like one read from stdin
+string checkSharedTrace(const fs::path &root) {
+    fs::path trace = root / "traces" / "swim.trace";
+    string plain, shared;
+    if (!runCsim("1024 4 32 write-allocate write-back lru", trace, plain)) {
+        return plain;
+    }
+    if (!runCsim("1024 4 32 write-allocate write-back lru --shared-trace", trace, shared)) {
+        return shared;
+    }
+    return plain == shared ? "" : "--shared-trace changed the output";
+}
+
+const PropertyCheck CHECKS[] = {
+    {"trace-round-trip", checkTraceRoundTrip},
+    {"false-sharing", checkFalseSharing},
+    {"sweep-tiles", checkTileSizes},
+    {"sweep-coroutines", checkSweepCoroutines},
+    {"results-query", checkResultsQuery},
+    {"tag-filter", checkTagFilter},
+    {"reuse-chunks", checkReuseChunks},
+    {"shared-trace", checkSharedTrace},
+};
+
+}
+
+int main(int argc, char **argv) {
+    Options opts;
+    string error;
+    unsigned long jobs;
+    if (!opts.parse(argc, argv, 1, error) || !opts.getUnsigned("jobs", 0, jobs, error)) {
+        cerr << "Error: " << error << "\n";
+        return 1;
+    }
+    fs::path root = opts.get("root", "..");
+    string policies = "," + opts.get("policy", "lru,fifo") + ",";
+    string cycles = opts.get("cycles", "");
+    double tolerance = cycles.empty() ? -1 : strtod(cycles.c_str(), nullptr);
+    bool generate = opts.has("generate");
+    if (!opts.firstUnused().empty()) {
+        cerr << "Usage: ./csim_test [--root=..] [--policy=lru,fifo] [--cycles=<percent>] "
+                "[--jobs=<threads>] [--generate]\n";
+        return 1;
+    }
+    fs::path goldenDir = root / "expected_results";
+    fs::path traceDir = root / "traces";
+
+    // the default configs for every selected policy, plus whatever golden
+    // files exist for the selected policies
+    vector<TestCase> cases;
+    set<string> seen;
+    auto addCase = [&](const TestCase &c) {
+        if (policies.find("," + c.policy + ",") != string::npos &&
+            seen.insert(c.trace + "/" + goldenName(c)).second) {
+            cases.push_back(c);
+        }
+    };
+    stringstream policyList(policies);
+    string policy;
+    while (getline(policyList, policy, ',')) {
+        if (policy.empty()) {
+            continue;
+        }
+        for (const Geometry &g : DEFAULT_CONFIGS) {
+            TestCase c;
+            c.trace = g.trace;
+            c.sets = g.sets;
+            c.ways = g.ways;
+            c.block = g.block;
+            c.writeAllocate = g.writeAllocate;
+            c.writeBack = g.writeBack;
+            c.policy = policy;
+            addCase(c);
+        }
+    }
+    error_code ec;
+    for (const fs::directory_entry &dir : fs::directory_iterator(goldenDir, ec)) {
+        if (!dir.is_directory()) {
+            continue;
+        }
+        for (const fs::directory_entry &file : fs::directory_iterator(dir.path(), ec)) {
+            TestCase c;
+            if (file.path().extension() == ".txt" &&
+                parseGoldenName(dir.path().filename().string(), file.path().stem().string(), c)) {
+                addCase(c);
+            }
+        }
+    }
+
+    auto start = chrono::steady_clock::now();
+    ThreadPool pool(jobs);
+
+    // every trace is decoded once, then shared read-only by its cases
+    map<string, vector<TraceRecord>> traces;
+    map<string, string> loadErrors; // empty once the trace is read
+    for (const TestCase &c : cases) {
+        traces[c.trace];
+        loadErrors[c.trace];
+    }
+    for (auto &entry : traces) {
+        const string &name = entry.first;
+        vector<TraceRecord> &records = entry.second;
+        string &error = loadErrors[name];
+        pool.submit([&traceDir, &name, &records, &error] {
+            FILE *in = fopen((traceDir / (name + ".trace")).c_str(), "r");
+            if (in == nullptr) {
+                error = "could not open it";
+            } else {
+                readTrace(in, records, error);
+                fclose(in);
+            }
+        });
+    }
+    pool.wait();
+
+    for (TestCase &c : cases) {
+        if (!loadErrors[c.trace].empty()) {
+            c.message = (traceDir / (c.trace + ".trace")).string() + ": " + loadErrors[c.trace];
+            continue;
+        }
+        const vector<TraceRecord> &records = traces[c.trace];
+        pool.submit([&c, &records, &goldenDir, &traceDir, tolerance, generate] {
+            runCase(c, records, goldenDir, traceDir, tolerance, generate);
+        });
+    }
+    const size_t numChecks = sizeof(CHECKS) / sizeof(CHECKS[0]);
+    vector<string> checkFailures(numChecks);
+    for (size_t i = 0; i < numChecks; i++) {
+        pool.submit([i, &root, &checkFailures] { checkFailures[i] = CHECKS[i].run(root); });
+    }
+    pool.wait();
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+    unsigned passed = 0, generated = 0;
+    for (const TestCase &c : cases) {
+        string label = c.trace + "/" + goldenName(c);
+        if (c.generated) {
+            cout << "GENERATED " << label << ": " << c.message << "\n";
+            generated++;
+        } else if (!c.passed) {
+            cout << "FAIL " << label << ": " << c.message << "\n";
+        }
+        passed += c.passed;
+    }
+    unsigned checksPassed = 0;
+    for (size_t i = 0; i < numChecks; i++) {
+        if (!checkFailures[i].empty()) {
+            cout << "FAIL check " << CHECKS[i].name << ": " << checkFailures[i] << "\n";
+        }
+        checksPassed += checkFailures[i].empty();
+    }
+    ThreadPool::Stats ps = pool.stats();
+    cout << cases.size() << " cases, " << passed << " passed, " << cases.size() - passed
+         << " failed, " << generated << " generated in " << ms << " ms on " << pool.size()
+         << " threads (" << ps.idleSeconds << " s idle, " << ps.contended << " contended locks)\n";
+    cout << numChecks << " checks, " << checksPassed << " passed, " << numChecks - checksPassed
+         << " failed\n";
+    return passed == cases.size() && checksPassed == numChecks ? 0 : 1;
+}
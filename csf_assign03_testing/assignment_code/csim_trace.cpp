@@ -0,0 +1,349 @@
+// csim-trace: streams a trace through a pipeline of transformation stages.
+// readers, each stage and the writer run on their own threads and pass
+// record batches along by pointer (see trace_stages.h). several inputs are
+// merged by time first, the output can be text or binary, and --split sends
+// each address region to its own file
+#include <atomic>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "options.h"
+#include "trace.h"
+#include "trace_stages.h"
+
+using namespace std;
+
+namespace {
+
+const size_t LINK_CAPACITY = 4; // batches queued between two threads
+
+vector<string> splitList(const string &text) {
+    vector<string> parts;
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t comma = text.find(',', start);
+        if (comma == string::npos) {
+            comma = text.size();
+        }
+        parts.push_back(text.substr(start, comma - start));
+        start = comma + 1;
+    }
+    return parts;
+}
+
+void readInput(FILE *in, BatchChannel &freeList, BatchChannel &out, atomic<unsigned long> &records,
+               string &error) {
+    TraceReader reader(in);
+    while (true) {
+        RecordBatch *batch = freeList.pop();
+        if (!reader.next(*batch)) {
+            freeList.push(batch);
+            break;
+        }
+        records += batch->count;
+        out.push(batch);
+    }
+    error = reader.error();
+    out.close();
+}
+
+// interleave the inputs by time (each stream's running sum of gaps). the
+// merged gaps are the time between neighbouring records, ties go to the
+// earlier input. this is the one place records get copied
+void mergeInputs(const vector<unique_ptr<BatchChannel>> &ins, BatchChannel &freeList,
+                 BatchChannel &out) {
+    struct Head {
+        RecordBatch *batch = nullptr;
+        size_t pos = 0;
+        uint64_t time = 0;
+        bool live = true;
+    };
+    vector<Head> heads(ins.size());
+    // make sure head i has a record to look at, false once its input is done
+    auto refill = [&](size_t i) {
+        Head &h = heads[i];
+        while (h.batch == nullptr || h.pos == h.batch->count) {
+            if (h.batch != nullptr) {
+                freeList.push(h.batch);
+            }
+            h.batch = ins[i]->pop();
+            h.pos = 0;
+            if (h.batch == nullptr) {
+                return false;
+            }
+        }
+        return true;
+    };
+    for (size_t i = 0; i < heads.size(); i++) {
+        heads[i].live = refill(i);
+    }
+
+    uint64_t last = 0;
+    RecordBatch *merged = freeList.pop();
+    merged->count = 0;
+    while (true) {
+        size_t best = heads.size();
+        uint64_t bestTime = 0;
+        for (size_t i = 0; i < heads.size(); i++) {
+            if (heads[i].live) {
+                uint64_t t = heads[i].time + heads[i].batch->records[heads[i].pos].gap;
+                if (best == heads.size() || t < bestTime) {
+                    best = i;
+                    bestTime = t;
+                }
+            }
+        }
+        if (best == heads.size()) {
+            break;
+        }
+        Head &h = heads[best];
+        TraceRecord rec = h.batch->records[h.pos++];
+        h.time = bestTime;
+        uint64_t gap = bestTime - last;
+        rec.gap = gap > MAX_GAP ? MAX_GAP : (uint32_t) gap;
+        last = bestTime;
+        merged->records[merged->count++] = rec;
+        if (merged->count == RecordBatch::CAPACITY) {
+            out.push(merged);
+            merged = freeList.pop();
+            merged->count = 0;
+        }
+        h.live = refill(best);
+    }
+    if (merged->count != 0) {
+        out.push(merged);
+    } else {
+        freeList.push(merged);
+    }
+    out.close();
+}
+
+void runStage(TraceStage &stage, BatchChannel &in, BatchChannel &freeList, BatchChannel &out) {
+    RecordBatch *batch;
+    while ((batch = in.pop()) != nullptr) {
+        stage.process(*batch);
+        if (batch->count != 0) {
+            out.push(batch);
+        } else {
+            freeList.push(batch);
+        }
+    }
+    out.close();
+}
+
+// one output file per address region, <output>.<region in hex>
+class RegionSplitter {
+public:
+    RegionSplitter(const string &prefix, unsigned bits, bool binary)
+        : prefix(prefix), bits(bits), binary(binary) {}
+
+    ~RegionSplitter() {
+        for (auto &entry : files) {
+            fclose(entry.second.file);
+        }
+    }
+
+    bool write(const RecordBatch &batch) {
+        for (size_t i = 0; i < batch.count; i++) {
+            uint32_t region = bits < 32 ? batch.records[i].addr >> bits : 0;
+            Output *o = output(region);
+            if (o == nullptr) {
+                return false;
+            }
+            o->pending->records[o->pending->count++] = batch.records[i];
+            if (o->pending->count == RecordBatch::CAPACITY && !flush(*o)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool finish() {
+        bool ok = true;
+        for (auto &entry : files) {
+            ok &= flush(entry.second);
+        }
+        return ok;
+    }
+
+private:
+    struct Output {
+        FILE *file;
+        unique_ptr<RecordBatch> pending;
+    };
+
+    Output *output(uint32_t region) {
+        auto it = files.find(region);
+        if (it != files.end()) {
+            return &it->second;
+        }
+        char suffix[16];
+        snprintf(suffix, sizeof(suffix), ".%x", region);
+        FILE *f = fopen((prefix + suffix).c_str(), "wb");
+        if (f == nullptr || (binary && !writeBinaryHeader(f))) {
+            return nullptr;
+        }
+        Output &o = files[region];
+        o.file = f;
+        o.pending.reset(new RecordBatch);
+        return &o;
+    }
+
+    bool flush(Output &o) {
+        bool ok = writeRecords(o.file, *o.pending, binary);
+        o.pending->count = 0;
+        return ok;
+    }
+
+    string prefix;
+    unsigned bits;
+    bool binary;
+    map<uint32_t, Output> files;
+};
+
+}
+
+int main(int argc, char **argv) {
+    Options opts;
+    string error;
+    if (!opts.parse(argc, argv, 1, error)) {
+        cerr << "Error: " << error << "\n";
+        return 1;
+    }
+    vector<string> inputs = splitList(opts.get("input", "-"));
+    string output = opts.get("output", "-");
+    string format = opts.get("format", "text");
+    vector<string> specs = splitList(opts.get("pipeline", ""));
+    // a bare --split makes 4KB (12-bit) regions
+    bool split = opts.has("split");
+    unsigned long splitBits = 12;
+    if (split && !opts.get("split", "").empty() && !opts.getUnsigned("split", 12, splitBits, error)) {
+        cerr << "Error: " << error << "\n";
+        return 1;
+    }
+    if (splitBits > 31) {
+        cerr << "Error: --split must be at most 31 bits.\n";
+        return 1;
+    }
+    if (!opts.firstUnused().empty() || (format != "text" && format != "binary") || inputs.empty()) {
+        cerr << "Usage: ./csim-trace [--input=<file|->[,<file>...]] [--output=<file|->] "
+                "[--format=text|binary] [--pipeline=<stage>[,<stage>...]] [--split[=<bits>]]\n";
+        return 1;
+    }
+    if (split && output == "-") {
+        cerr << "Error: --split needs --output as the file name prefix.\n";
+        return 1;
+    }
+    bool binary = format == "binary";
+
+    vector<unique_ptr<TraceStage>> stages;
+    for (const string &spec : specs) {
+        stages.push_back(makeStage(spec, error));
+        if (stages.back() == nullptr) {
+            cerr << "Error: " << error << "\n";
+            return 1;
+        }
+    }
+
+    vector<FILE *> files;
+    for (const string &name : inputs) {
+        FILE *f = name == "-" ? stdin : fopen(name.c_str(), "rb");
+        if (f == nullptr) {
+            cerr << "Error: could not open " << name << "\n";
+            return 1;
+        }
+        files.push_back(f);
+    }
+    FILE *out = output == "-" ? stdout : (split ? nullptr : fopen(output.c_str(), "wb"));
+    if (!split && out == nullptr) {
+        cerr << "Error: could not open " << output << "\n";
+        return 1;
+    }
+
+    // enough batches that every link can be full while each thread holds one
+    size_t poolSize = (LINK_CAPACITY + 2) * (files.size() + stages.size() + 2);
+    vector<unique_ptr<RecordBatch>> pool;
+    BatchChannel freeList(poolSize);
+    for (size_t i = 0; i < poolSize; i++) {
+        pool.emplace_back(new RecordBatch);
+        freeList.push(pool.back().get());
+    }
+    // links[0] carries the (merged) input, links[i + 1] the output of stage i
+    vector<unique_ptr<BatchChannel>> links;
+    for (size_t i = 0; i <= stages.size(); i++) {
+        links.emplace_back(new BatchChannel(LINK_CAPACITY));
+    }
+
+    atomic<unsigned long> recordsIn{0};
+    vector<string> readErrors(files.size()); // one per reader, looked at after the join
+    vector<thread> threads;
+    vector<unique_ptr<BatchChannel>> sources;
+    if (files.size() == 1) {
+        threads.emplace_back(readInput, files[0], ref(freeList), ref(*links[0]), ref(recordsIn),
+                             ref(readErrors[0]));
+    } else {
+        for (size_t i = 0; i < files.size(); i++) {
+            sources.emplace_back(new BatchChannel(LINK_CAPACITY));
+            threads.emplace_back(readInput, files[i], ref(freeList), ref(*sources.back()),
+                                 ref(recordsIn), ref(readErrors[i]));
+        }
+        threads.emplace_back(mergeInputs, cref(sources), ref(freeList), ref(*links[0]));
+    }
+    for (size_t i = 0; i < stages.size(); i++) {
+        threads.emplace_back(runStage, ref(*stages[i]), ref(*links[i]), ref(freeList),
+                             ref(*links[i + 1]));
+    }
+
+    // the writer runs here
+    unsigned long recordsOut = 0;
+    bool writeOk = true;
+    unique_ptr<RegionSplitter> splitter;
+    if (split) {
+        splitter.reset(new RegionSplitter(output, splitBits, binary));
+    } else if (binary) {
+        writeOk = writeBinaryHeader(out);
+    }
+    RecordBatch *batch;
+    while ((batch = links.back()->pop()) != nullptr) {
+        recordsOut += batch->count;
+        if (writeOk) {
+            writeOk = split ? splitter->write(*batch) : writeRecords(out, *batch, binary);
+        }
+        freeList.push(batch);
+    }
+    for (thread &t : threads) {
+        t.join();
+    }
+    if (split) {
+        writeOk &= splitter->finish();
+        splitter.reset();
+    } else {
+        writeOk &= fflush(out) == 0;
+        if (out != stdout) {
+            writeOk &= fclose(out) == 0;
+        }
+    }
+    for (FILE *f : files) {
+        if (f != stdin) {
+            fclose(f);
+        }
+    }
+
+    cerr << "csim-trace: " << recordsIn << " records in, " << recordsOut << " out\n";
+    for (size_t i = 0; i < files.size(); i++) {
+        if (!readErrors[i].empty()) {
+            cerr << "Error: " << (inputs[i] == "-" ? "stdin" : inputs[i]) << ": " << readErrors[i]
+                 << "\n";
+            return 1;
+        }
+    }
+    if (!writeOk) {
+        cerr << "Error: could not write the output\n";
+        return 1;
+    }
+    return 0;
+}
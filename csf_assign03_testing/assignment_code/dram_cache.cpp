@@ -0,0 +1,325 @@
+#include "dram_cache.h"
+
+using namespace std;
+
+namespace {
+
+const unsigned long HBM_WORD = 25; // cycles per 4 bytes moved on the HBM
+const unsigned long DDR_WORD = 100; // same as plain memory in the cache model
+const unsigned TAG_BYTES = 8; // one stored tag with its state bits
+const unsigned long SRAM_TAG_CYCLES = 2;
+const uint8_t PREDICT_MISS = 4; // counter at or above: predicted miss
+
+bool isPowerOfTwo(unsigned long n) {
+    return n > 0 && (n & (n - 1)) == 0;
+}
+
+unsigned log2u(unsigned n) {
+    unsigned bits = 0;
+    while ((1u << bits) < n) {
+        bits++;
+    }
+    return bits;
+}
+
+unsigned long words(unsigned long bytes) {
+    return (bytes + 3) / 4;
+}
+
+}
+
+bool parseDramOptions(Options &opts, unsigned l1BlockSize, DramConfig &config, string &error) {
+    string tags = opts.get("dram-tags", "sram");
+    if (tags == "sram") {
+        config.tags = DramTags::SRAM;
+    } else if (tags == "alloy") {
+        config.tags = DramTags::ALLOY;
+    } else {
+        error = "--dram-tags must be sram or alloy";
+        return false;
+    }
+    // an alloy cache reads one tag per burst, so it is direct mapped
+    unsigned defaultWays = config.tags == DramTags::ALLOY ? 1 : config.ways;
+
+    unsigned long size, block, subBlock, ways, tagCache;
+    if (!opts.getUnsigned("dram-cache", config.sizeKB, size, error) ||
+        !opts.getUnsigned("dram-block", config.blockSize, block, error) ||
+        !opts.getUnsigned("dram-sub-block", max(config.subBlockSize, l1BlockSize), subBlock, error) ||
+        !opts.getUnsigned("dram-ways", defaultWays, ways, error) ||
+        !opts.getUnsigned("dram-tag-cache", config.tagCacheSets, tagCache, error)) {
+        return false;
+    }
+    config.predictMisses = opts.has("dram-predict");
+    if (size == 0) {
+        for (const char *name : {"dram-block", "dram-sub-block", "dram-ways", "dram-tag-cache",
+                                 "dram-tags", "dram-predict"}) {
+            if (opts.has(name)) {
+                error = "--dram-block, --dram-sub-block, --dram-ways, --dram-tag-cache, "
+                        "--dram-tags and --dram-predict need --dram-cache";
+                return false;
+            }
+        }
+        return true;
+    }
+    if (!isPowerOfTwo(block) || !isPowerOfTwo(subBlock) || subBlock < l1BlockSize ||
+        block < subBlock || block / subBlock > 64) {
+        error = "--dram-block and --dram-sub-block must be powers of two, with one to 64 "
+                "sub-blocks per block and the cache's blocks fitting in a sub-block";
+        return false;
+    }
+    if (!isPowerOfTwo(ways) || (config.tags == DramTags::ALLOY && ways != 1)) {
+        error = "--dram-ways must be a power of two, and 1 for --dram-tags=alloy";
+        return false;
+    }
+    if (size * 1024 / block / ways == 0 || !isPowerOfTwo(size * 1024 / block / ways)) {
+        error = "--dram-cache must give a power-of-two number of sets of --dram-ways blocks";
+        return false;
+    }
+    if (!isPowerOfTwo(tagCache) || tagCache < 4) {
+        error = "--dram-tag-cache must be a power of two of at least 4";
+        return false;
+    }
+    config.sizeKB = size;
+    config.blockSize = block;
+    config.subBlockSize = subBlock;
+    config.ways = ways;
+    config.tagCacheSets = tagCache;
+    return true;
+}
+
+DramCache::DramCache(const DramConfig &config, Arena &arena) : cfg(config) {
+    pageBits = log2u(cfg.blockSize);
+    subBits = log2u(cfg.subBlockSize);
+    numSets = (uint32_t) ((unsigned long) cfg.sizeKB * 1024 / cfg.blockSize / cfg.ways);
+    frames = arena.make<Frame>((size_t) numSets * cfg.ways);
+    footprints = arena.make<Footprint>(FOOTPRINTS);
+    offsetFootprints = arena.make<uint64_t>(64);
+    tagCache = arena.make<uint32_t>(cfg.tagCacheSets);
+    tagCacheUsed = arena.make<uint32_t>(cfg.tagCacheSets);
+    predictor = arena.make<uint8_t>(256);
+}
+
+unsigned long DramCache::tagCheck(uint32_t set) {
+    if (cfg.tags == DramTags::ALLOY) {
+        // the tag rides along with the data in a slightly longer burst
+        hbmBytes += TAG_BYTES;
+        return words(TAG_BYTES) * HBM_WORD;
+    }
+
+    // SRAM tag cache, 4-way lru over whole sets' tags
+    tagCacheLookups++;
+    uint32_t *entries = tagCache + (set & (cfg.tagCacheSets / TAG_CACHE_WAYS - 1)) * TAG_CACHE_WAYS;
+    uint32_t *used = tagCacheUsed + (entries - tagCache);
+    unsigned victim = 0;
+    for (unsigned i = 0; i < TAG_CACHE_WAYS; i++) {
+        if (entries[i] == set + 1) {
+            tagCacheHits++;
+            used[i] = now;
+            return SRAM_TAG_CYCLES;
+        }
+        if (used[i] < used[victim]) {
+            victim = i;
+        }
+    }
+    // read the set's tags out of DRAM first
+    entries[victim] = set + 1;
+    used[victim] = now;
+    hbmBytes += TAG_BYTES * cfg.ways;
+    return SRAM_TAG_CYCLES + words(TAG_BYTES * cfg.ways) * HBM_WORD;
+}
+
+DramCache::Frame *DramCache::find(uint32_t set, uint32_t page) {
+    Frame *f = frames + (size_t) set * cfg.ways;
+    for (unsigned i = 0; i < cfg.ways; i++) {
+        if (f[i].valid && f[i].page == page) {
+            return &f[i];
+        }
+    }
+    return nullptr;
+}
+
+DramCache::Frame *DramCache::allocate(uint32_t set, uint32_t page, unsigned trigger) {
+    Frame *f = frames + (size_t) set * cfg.ways;
+    Frame *victim = &f[0];
+    for (unsigned i = 0; i < cfg.ways; i++) {
+        if (!f[i].valid) {
+            victim = &f[i];
+            break;
+        }
+        if (f[i].lastUsed < victim->lastUsed) {
+            victim = &f[i];
+        }
+    }
+
+    if (victim->valid) {
+        // remember what the page used, and write its dirty sub-blocks to DDR
+        uint64_t key = footprintKey(victim->page, victim->trigger);
+        Footprint &fp = footprints[(key - 1) % FOOTPRINTS];
+        fp.key = key;
+        fp.mask = victim->used;
+        offsetFootprints[victim->trigger] = victim->used;
+        unsigned long dirty = __builtin_popcountll(victim->dirty);
+        hbmBytes += dirty * cfg.subBlockSize;
+        ddrBytes += dirty * cfg.subBlockSize;
+        usedSubBlocks += __builtin_popcountll(victim->present & victim->used);
+        evictedSubBlocks += __builtin_popcountll(victim->present);
+    }
+    victim->valid = 1;
+    victim->page = page;
+    victim->present = 0;
+    victim->used = 0;
+    victim->dirty = 0;
+    victim->trigger = (uint8_t) trigger;
+    if (cfg.tags == DramTags::SRAM) {
+        hbmBytes += TAG_BYTES; // new tag written next to the data
+    }
+    return victim;
+}
+
+uint64_t DramCache::predictFootprint(uint32_t page, unsigned trigger) const {
+    // the page's own last footprint if we still have it, else whatever the
+    // last page brought in by the same sub-block used
+    uint64_t key = footprintKey(page, trigger);
+    const Footprint &fp = footprints[(key - 1) % FOOTPRINTS];
+    if (fp.key == key) {
+        return fp.mask;
+    }
+    return offsetFootprints[trigger];
+}
+
+void DramCache::fill(Frame &frame, uint64_t mask) {
+    mask &= ~frame.present;
+    unsigned long n = __builtin_popcountll(mask);
+    ddrBytes += n * cfg.subBlockSize;
+    hbmBytes += n * (cfg.subBlockSize + (cfg.tags == DramTags::ALLOY ? TAG_BYTES : 0));
+    fetchedSubBlocks += n;
+    frame.present |= mask;
+}
+
+bool DramCache::predictMiss(uint32_t page, bool miss) {
+    if (!cfg.predictMisses) {
+        return false;
+    }
+    uint8_t &c = predictor[(page * 0x9e3779b9u) >> 24];
+    bool predicted = c >= PREDICT_MISS;
+    predictions++;
+    predictedRight += predicted == miss;
+    if (miss && c < 7) {
+        c++;
+    } else if (!miss && c > 0) {
+        c--;
+    }
+    return predicted;
+}
+
+unsigned long DramCache::read(uint32_t addr, unsigned bytes) {
+    now++;
+    reads++;
+    demandBytes += bytes;
+    uint32_t page = addr >> pageBits;
+    unsigned sub = (addr >> subBits) & ((1u << (pageBits - subBits)) - 1);
+    uint64_t bit = 1ull << sub;
+    uint32_t set = page & (numSets - 1);
+
+    unsigned long tag = tagCheck(set);
+    Frame *frame = find(set, page);
+    bool hit = frame != nullptr && (frame->present & bit);
+    bool parallel = predictMiss(page, !hit);
+
+    if (hit) {
+        unsigned long data = words(bytes) * HBM_WORD;
+        hbmBytes += bytes;
+        if (parallel) {
+            ddrBytes += bytes; // the DDR read we started was not needed
+        }
+        frame->used |= bit;
+        frame->lastUsed = now;
+        hits++;
+        hitTagCycles += tag;
+        hitDataCycles += data;
+        return tag + data;
+    }
+
+    // miss: DDR sends the demanded data, the sub-blocks follow into the page
+    unsigned long ddr = words(bytes) * DDR_WORD;
+    unsigned long latency = parallel ? max(tag, ddr) : tag + ddr;
+    if (cfg.tags == DramTags::ALLOY) {
+        hbmBytes += bytes; // the probe burst carried (the wrong) data too
+    }
+    if (frame != nullptr) {
+        subBlockMisses++;
+        fill(*frame, bit);
+    } else {
+        pageMisses++;
+        frame = allocate(set, page, sub);
+        fill(*frame, predictFootprint(page, sub) | bit);
+    }
+    frame->used |= bit;
+    frame->lastUsed = now;
+    missTagCycles += latency - ddr;
+    missMemCycles += ddr;
+    return latency;
+}
+
+unsigned long DramCache::write(uint32_t addr, unsigned bytes) {
+    now++;
+    writes++;
+    demandBytes += bytes;
+    uint32_t page = addr >> pageBits;
+    unsigned sub = (addr >> subBits) & ((1u << (pageBits - subBits)) - 1);
+    uint64_t bit = 1ull << sub;
+    uint32_t set = page & (numSets - 1);
+
+    unsigned long tag = tagCheck(set);
+    Frame *frame = find(set, page);
+    if (frame != nullptr && (frame->present & bit)) {
+        hbmBytes += bytes;
+        frame->dirty |= bit;
+        frame->used |= bit;
+        frame->lastUsed = now;
+        return tag + words(bytes) * HBM_WORD;
+    }
+    // not cached, write around to DDR
+    ddrBytes += bytes;
+    return tag + words(bytes) * DDR_WORD;
+}
+
+void DramCache::report(csim_report_fn emit, void *out) const {
+    unsigned long misses = pageMisses + subBlockMisses;
+    emit(out, "DRAM cache reads", (double) reads);
+    emit(out, "DRAM cache writes", (double) writes);
+    emit(out, "DRAM cache read hits", (double) hits);
+    emit(out, "DRAM cache page misses", (double) pageMisses);
+    emit(out, "DRAM cache sub-block misses", (double) subBlockMisses);
+    emit(out, "DRAM cache hit rate", reads ? (double) hits / reads : 0.0);
+    emit(out, "DRAM cache hit latency", hits ? (double) (hitTagCycles + hitDataCycles) / hits : 0.0);
+    emit(out, "DRAM cache hit tag cycles", hits ? (double) hitTagCycles / hits : 0.0);
+    emit(out, "DRAM cache hit data cycles", hits ? (double) hitDataCycles / hits : 0.0);
+    emit(out, "DRAM cache miss latency",
+         misses ? (double) (missTagCycles + missMemCycles) / misses : 0.0);
+    emit(out, "DRAM cache miss tag cycles", misses ? (double) missTagCycles / misses : 0.0);
+    emit(out, "DRAM cache miss memory cycles", misses ? (double) missMemCycles / misses : 0.0);
+    if (cfg.tags == DramTags::SRAM) {
+        emit(out, "DRAM cache tag cache hit rate",
+             tagCacheLookups ? (double) tagCacheHits / tagCacheLookups : 0.0);
+    }
+    if (cfg.predictMisses) {
+        emit(out, "DRAM cache miss predictor accuracy",
+             predictions ? (double) predictedRight / predictions : 0.0);
+    }
+
+    // footprint accuracy over evicted and still resident pages
+    unsigned long used = usedSubBlocks;
+    unsigned long filled = evictedSubBlocks;
+    for (size_t i = 0; i < (size_t) numSets * cfg.ways; i++) {
+        used += __builtin_popcountll(frames[i].present & frames[i].used);
+        filled += __builtin_popcountll(frames[i].present);
+    }
+    emit(out, "DRAM cache fetched sub-blocks", (double) fetchedSubBlocks);
+    emit(out, "DRAM cache footprint accuracy", filled ? (double) used / filled : 0.0);
+    emit(out, "DRAM cache HBM bytes", (double) hbmBytes);
+    emit(out, "DRAM cache DDR bytes", (double) ddrBytes);
+    // bloat: bytes moved per byte the cache above asked for
+    emit(out, "DRAM cache HBM bloat", demandBytes ? (double) hbmBytes / demandBytes : 0.0);
+    emit(out, "DRAM cache DDR bloat", demandBytes ? (double) ddrBytes / demandBytes : 0.0);
+}
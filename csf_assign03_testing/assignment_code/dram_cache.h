@@ -0,0 +1,117 @@
+#ifndef DRAM_CACHE_H
+#define DRAM_CACHE_H
+
+#include <cstdint>
+#include <string>
+#include "arena.h"
+#include "cache.h"
+#include "csim_policy.h"
+#include "options.h"
+
+// where the DRAM cache keeps its tags
+enum class DramTags : uint8_t {
+    SRAM, // in DRAM next to the data, with an SRAM cache of recently used sets' tags
+    ALLOY // alloy cache: each sub-block is read together with its tag in one burst
+};
+
+// set from the --dram-* options
+struct DramConfig {
+    unsigned sizeKB = 0; // 0 for no DRAM cache
+    unsigned blockSize = 2048; // page-sized blocks
+    unsigned subBlockSize = 64; // what gets filled and tracked, at most 64 per block
+    unsigned ways = 4;
+    DramTags tags = DramTags::SRAM;
+    unsigned tagCacheSets = 256; // SRAM tag cache entries, each holds one set's tags
+    bool predictMisses = false; // MAP-I style hit/miss predictor
+};
+
+// read --dram-cache=<KB> and the other --dram-* options. l1BlockSize is the
+// block size of the cache above, which has to fit in one sub-block. returns
+// false and sets error on a bad value
+bool parseDramOptions(Options &opts, unsigned l1BlockSize, DramConfig &config, std::string &error);
+
+// an HBM-style DRAM cache between the cache and DDR memory. blocks are
+// page sized, but only sub-blocks are filled: on a miss the page's footprint
+// (the sub-blocks used during its last stay) is fetched along with the
+// demanded one. tags live in DRAM, either read with the data (alloy) or
+// looked up through an SRAM tag cache, and an optional miss predictor starts
+// the DDR access in parallel with the tag check. HBM moves data four times
+// as fast as DDR, which costs what plain memory costs in the cache model.
+// placed in the arena and never destroyed, like the prefetchers
+class DramCache : public LowerLevel {
+public:
+    DramCache(const DramConfig &config, Arena &arena);
+
+    unsigned long read(uint32_t addr, unsigned bytes) override;
+    unsigned long write(uint32_t addr, unsigned bytes) override;
+
+    // hit/miss counts, latency breakdown, tag cache and predictor hit rates,
+    // footprint accuracy and bandwidth bloat
+    void report(csim_report_fn emit, void *out) const;
+
+private:
+    // one page frame
+    struct Frame {
+        uint64_t present; // sub-blocks filled
+        uint64_t used; // sub-blocks the cache above asked for
+        uint64_t dirty;
+        uint32_t page; // page number (address / block size)
+        uint32_t lastUsed;
+        uint8_t valid;
+        uint8_t trigger; // sub-block that brought the page in
+    };
+
+    // remembered footprint of a page (exact) or a trigger offset (fallback)
+    struct Footprint {
+        uint64_t key; // page << 6 | trigger, plus one so 0 is empty
+        uint64_t mask;
+    };
+
+    static const unsigned FOOTPRINTS = 1024;
+    static const unsigned TAG_CACHE_WAYS = 4;
+
+    unsigned long tagCheck(uint32_t set);
+    Frame *find(uint32_t set, uint32_t page);
+    Frame *allocate(uint32_t set, uint32_t page, unsigned trigger);
+    void fill(Frame &frame, uint64_t mask);
+    uint64_t predictFootprint(uint32_t page, unsigned trigger) const;
+    // 64 bits wide: a page number above 2^26 loses its top bits in 32
+    static uint64_t footprintKey(uint32_t page, unsigned trigger) {
+        return ((uint64_t) page << 6 | trigger) + 1;
+    }
+    bool predictMiss(uint32_t page, bool miss);
+
+    DramConfig cfg;
+    unsigned pageBits;
+    unsigned subBits;
+    uint32_t numSets;
+    Frame *frames;
+    Footprint *footprints; // exact pages
+    uint64_t *offsetFootprints; // by trigger offset only
+    uint32_t *tagCache; // set + 1 per entry, 0 when empty
+    uint32_t *tagCacheUsed;
+    uint8_t *predictor; // 3-bit counters, high means miss
+    uint32_t now = 0;
+
+    unsigned long reads = 0;
+    unsigned long writes = 0;
+    unsigned long hits = 0;
+    unsigned long pageMisses = 0;
+    unsigned long subBlockMisses = 0;
+    unsigned long hitTagCycles = 0;
+    unsigned long hitDataCycles = 0;
+    unsigned long missTagCycles = 0; // tag check time not hidden behind DDR
+    unsigned long missMemCycles = 0;
+    unsigned long tagCacheLookups = 0;
+    unsigned long tagCacheHits = 0;
+    unsigned long predictions = 0;
+    unsigned long predictedRight = 0;
+    unsigned long fetchedSubBlocks = 0;
+    unsigned long usedSubBlocks = 0; // of the fetched ones in evicted pages
+    unsigned long evictedSubBlocks = 0;
+    unsigned long demandBytes = 0;
+    unsigned long hbmBytes = 0;
+    unsigned long ddrBytes = 0;
+};
+
+#endif
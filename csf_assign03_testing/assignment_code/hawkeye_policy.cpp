@@ -0,0 +1,251 @@
+// Hawkeye (Jain & Lin, ISCA 2016): learn from what Belady's OPT would have
+// done. a sample of the sets runs OPTgen, which replays each sampled set's
+// recent accesses against an occupancy vector to decide whether OPT would
+// have hit. those labels train a table of saturating counters, and the
+// counters decide RRIP insertion for every set: cache-friendly blocks go in
+// at RRPV 0, cache-averse ones at the distant RRPV. the traces have no PC, so
+// the predictor is keyed by a hash of the block's region instead, 4KB unless
+// the policy is given as hawkeye:<region bits>
+#include <cstdlib>
+#include "policy.h"
+
+using namespace std;
+
+namespace {
+
+const unsigned MAX_SAMPLED = 64; // sets running OPTgen
+const unsigned HISTORY_FACTOR = 8; // OPTgen looks back this many times the associativity
+const unsigned PREDICTOR_BITS = 11; // 2048 counters
+const uint8_t COUNTER_MAX = 7;
+const uint8_t FRIENDLY = 1; // counter at or above: cache-friendly
+const uint8_t RRPV_MAX = 7;
+
+// per-line metadata
+struct LineMeta {
+    uint8_t rrpv;
+    uint8_t friendly; // prediction at the last access
+    uint16_t signature;
+    uint32_t lastUsed; // breaks rrpv ties, oldest goes first
+};
+
+// one past access of a sampled set
+struct SamplerEntry {
+    uint32_t block;
+    uint32_t time; // set-local access count, 0 means empty
+    uint16_t signature;
+};
+
+struct Hawkeye {
+    uint32_t ways;
+    uint32_t offsetBits; // log2 of the block size
+    uint32_t regionBits; // signature granularity
+    uint32_t history; // length of each occupancy vector
+    int16_t *sampleIndex; // per set, -1 when not sampled
+    uint8_t *occupancy; // history counters per sampled set, circular
+    uint32_t *setTime; // per sampled set
+    SamplerEntry *sampler; // history entries per sampled set
+    uint8_t *counters;
+    // reporting
+    unsigned long optAccesses;
+    unsigned long optHits;
+    unsigned long trained;
+    unsigned long agreed; // predictor already agreed with OPT
+    unsigned long friendlyFills;
+    unsigned long fills;
+};
+
+uint16_t signatureOf(const Hawkeye *h, uint32_t addr) {
+    uint32_t x = (addr >> h->regionBits) * 0x9e3779b9u;
+    return (uint16_t) (x >> (32 - PREDICTOR_BITS));
+}
+
+void train(Hawkeye *h, uint16_t signature, bool optHit) {
+    uint8_t &c = h->counters[signature];
+    h->trained++;
+    h->agreed += (c >= FRIENDLY) == optHit;
+    if (optHit && c < COUNTER_MAX) {
+        c++;
+    } else if (!optHit && c > 0) {
+        c--;
+    }
+}
+
+// OPTgen: would OPT have kept this block since its previous access?
+void optgen(Hawkeye *h, const csim_access *a) {
+    int idx = h->sampleIndex[a->set];
+    if (idx < 0) {
+        return;
+    }
+    uint8_t *occ = h->occupancy + (size_t) idx * h->history;
+    SamplerEntry *entries = h->sampler + (size_t) idx * h->history;
+    uint32_t now = ++h->setTime[idx];
+    occ[now % h->history] = 0; // the slot being reused is a fresh quantum
+    uint32_t block = a->addr >> h->offsetBits;
+    uint16_t signature = signatureOf(h, a->addr);
+    h->optAccesses++;
+
+    // find the previous access to the block, remembering the oldest entry
+    SamplerEntry *found = nullptr;
+    SamplerEntry *oldest = &entries[0];
+    for (uint32_t i = 0; i < h->history; i++) {
+        if (entries[i].time != 0 && entries[i].block == block) {
+            found = &entries[i];
+            break;
+        }
+        if (entries[i].time < oldest->time) {
+            oldest = &entries[i];
+        }
+    }
+
+    if (found != nullptr && now - found->time < h->history) {
+        // OPT hits if the cache had room at every quantum in between
+        bool fits = true;
+        for (uint32_t t = found->time; t != now; t++) {
+            if (occ[t % h->history] >= h->ways) {
+                fits = false;
+                break;
+            }
+        }
+        if (fits) {
+            for (uint32_t t = found->time; t != now; t++) {
+                occ[t % h->history]++;
+            }
+            h->optHits++;
+        }
+        train(h, found->signature, fits);
+    } else if (found != nullptr) {
+        train(h, found->signature, false); // reuse too far away for OPT
+    }
+
+    SamplerEntry *e = found != nullptr ? found : oldest;
+    e->block = block;
+    e->time = now;
+    e->signature = signature;
+}
+
+void *hawkeyeCreate(const csim_policy_config *config) {
+    unsigned long regionBits = 12;
+    if (config->args[0] != '\0') {
+        char *end;
+        regionBits = strtoul(config->args, &end, 10);
+        if (*end != '\0' || regionBits < 1 || regionBits > 31) {
+            return nullptr;
+        }
+    }
+    Hawkeye *h = static_cast<Hawkeye *>(config->alloc(config->arena, sizeof(Hawkeye), alignof(Hawkeye)));
+    h->ways = config->ways;
+    h->regionBits = (uint32_t) regionBits;
+    h->history = HISTORY_FACTOR * config->ways;
+    while ((1u << h->offsetBits) < config->block_size) {
+        h->offsetBits++;
+    }
+
+    // spread the sampled sets evenly over the cache
+    unsigned sampled = config->num_sets < MAX_SAMPLED ? config->num_sets : MAX_SAMPLED;
+    unsigned stride = config->num_sets / sampled;
+    h->sampleIndex = static_cast<int16_t *>(config->alloc(config->arena,
+                                                          sizeof(int16_t) * config->num_sets, 2));
+    for (uint32_t s = 0; s < config->num_sets; s++) {
+        h->sampleIndex[s] = (s % stride == 0 && s / stride < sampled) ? (int16_t) (s / stride) : -1;
+    }
+    h->occupancy = static_cast<uint8_t *>(config->alloc(config->arena, (size_t) sampled * h->history, 1));
+    h->setTime = static_cast<uint32_t *>(config->alloc(config->arena, sizeof(uint32_t) * sampled, 4));
+    h->sampler = static_cast<SamplerEntry *>(config->alloc(
+        config->arena, sizeof(SamplerEntry) * sampled * h->history, alignof(SamplerEntry)));
+    h->counters = static_cast<uint8_t *>(config->alloc(config->arena, 1u << PREDICTOR_BITS, 1));
+    for (unsigned i = 0; i < (1u << PREDICTOR_BITS); i++) {
+        h->counters[i] = FRIENDLY; // start out trusting the cache
+    }
+    return h;
+}
+
+LineMeta *lines(uint8_t *lineMeta) {
+    return reinterpret_cast<LineMeta *>(lineMeta);
+}
+
+void hawkeyeHit(void *ctx, const csim_access *access, uint8_t *, uint8_t *lineMeta, uint32_t way) {
+    Hawkeye *h = static_cast<Hawkeye *>(ctx);
+    optgen(h, access);
+    LineMeta &m = lines(lineMeta)[way];
+    m.signature = signatureOf(h, access->addr);
+    m.friendly = h->counters[m.signature] >= FRIENDLY;
+    m.rrpv = m.friendly ? 0 : RRPV_MAX;
+    m.lastUsed = (uint32_t) access->now;
+}
+
+void hawkeyeHitBatch(void *ctx, const csim_hit *hits, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        hawkeyeHit(ctx, &hits[i].access, hits[i].set_meta, hits[i].line_meta, hits[i].way);
+    }
+}
+
+uint32_t hawkeyeVictim(void *ctx, const csim_access *access, uint8_t *, uint8_t *lineMeta,
+                       uint32_t firstInvalid) {
+    Hawkeye *h = static_cast<Hawkeye *>(ctx);
+    optgen(h, access);
+    if (firstInvalid < h->ways) {
+        return firstInvalid;
+    }
+
+    // highest rrpv, oldest first among equals. averse lines sit at the top;
+    // having to evict a friendly line means its signature was too optimistic
+    LineMeta *m = lines(lineMeta);
+    uint32_t victim = 0;
+    for (uint32_t i = 1; i < h->ways; i++) {
+        if (m[i].rrpv > m[victim].rrpv ||
+            (m[i].rrpv == m[victim].rrpv && m[i].lastUsed < m[victim].lastUsed)) {
+            victim = i;
+        }
+    }
+    if (m[victim].rrpv != RRPV_MAX) {
+        uint8_t &c = h->counters[m[victim].signature];
+        if (c > 0) {
+            c--;
+        }
+    }
+    return victim;
+}
+
+// a no-write-allocate store miss still belongs in the sampled set's history
+void hawkeyeBypass(void *ctx, const csim_access *access, uint8_t *, uint8_t *) {
+    optgen(static_cast<Hawkeye *>(ctx), access);
+}
+
+void hawkeyeFill(void *ctx, const csim_access *access, uint8_t *, uint8_t *lineMeta, uint32_t way) {
+    Hawkeye *h = static_cast<Hawkeye *>(ctx);
+    LineMeta *m = lines(lineMeta);
+    LineMeta &line = m[way];
+    line.signature = signatureOf(h, access->addr);
+    line.friendly = h->counters[line.signature] >= FRIENDLY;
+    line.lastUsed = (uint32_t) access->now;
+    h->fills++;
+    if (!line.friendly) {
+        line.rrpv = RRPV_MAX;
+        return;
+    }
+    // age the other friendly lines so older ones go first
+    for (uint32_t i = 0; i < h->ways; i++) {
+        if (i != way && m[i].rrpv < RRPV_MAX - 1) {
+            m[i].rrpv++;
+        }
+    }
+    line.rrpv = 0;
+    h->friendlyFills++;
+}
+
+void hawkeyeReport(void *ctx, csim_report_fn emit, void *out) {
+    Hawkeye *h = static_cast<Hawkeye *>(ctx);
+    emit(out, "Hawkeye sampled accesses", (double) h->optAccesses);
+    emit(out, "Hawkeye OPT hit rate", h->optAccesses ? (double) h->optHits / h->optAccesses : 0.0);
+    emit(out, "Hawkeye predictor accuracy", h->trained ? (double) h->agreed / h->trained : 0.0);
+    emit(out, "Hawkeye friendly fills", h->fills ? (double) h->friendlyFills / h->fills : 0.0);
+}
+
+}
+
+const csim_policy hawkeyePolicy = {
+    CSIM_POLICY_ABI_VERSION, sizeof(LineMeta), 0, "hawkeye",
+    hawkeyeCreate, nullptr, nullptr,
+    hawkeyeHit, hawkeyeFill, hawkeyeVictim,
+    hawkeyeHitBatch, hawkeyeReport, hawkeyeBypass
+};
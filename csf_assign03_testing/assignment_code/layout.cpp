@@ -0,0 +1,220 @@
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <memory>
+#include "audit.h"
+#include "layout.h"
+#include "thread_pool.h"
+
+using namespace std;
+
+namespace {
+
+const unsigned PAGE_BITS = 12;
+// pages between two regions, at least
+const uint32_t REGION_GAP = 256;
+const size_t TILE = 1 << 16;
+
+uint64_t splitmix(uint64_t &state) {
+    uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+// the region of every record, regions numbered from the lowest address, and
+// how many pages each region can move up before it reaches the next region,
+// as it is in the trace, or runs off the top of the 32-bit address space
+unsigned findRegions(span<const TraceRecord> records, vector<uint16_t> &regionOf,
+                     vector<uint32_t> &room) {
+    vector<uint32_t> pages;
+    pages.reserve(records.size());
+    for (const TraceRecord &rec : records) {
+        pages.push_back(rec.addr >> PAGE_BITS);
+    }
+    sort(pages.begin(), pages.end());
+    pages.erase(unique(pages.begin(), pages.end()), pages.end());
+    vector<uint32_t> starts; // first page of each region
+    for (size_t i = 0; i < pages.size(); i++) {
+        if ((i == 0 || pages[i] - pages[i - 1] >= REGION_GAP) && starts.size() < UINT16_MAX) {
+            starts.push_back(pages[i]);
+        }
+    }
+    room.assign(starts.size(), 0);
+    for (size_t r = 0, i = 0; r < starts.size(); r++) {
+        uint32_t last = pages[i];
+        while (i < pages.size() && (r + 1 == starts.size() || pages[i] < starts[r + 1])) {
+            last = pages[i++];
+        }
+        uint32_t next = r + 1 < starts.size() ? starts[r + 1] : 1u << (32 - PAGE_BITS);
+        room[r] = next - 1 - last;
+    }
+    regionOf.resize(records.size());
+    for (size_t i = 0; i < records.size(); i++) {
+        uint32_t page = records[i].addr >> PAGE_BITS;
+        regionOf[i] = (uint16_t) (upper_bound(starts.begin(), starts.end(), page) - starts.begin() - 1);
+    }
+    return starts.size();
+}
+
+// one layout: its engine and how far each region moves
+struct Layout {
+    Cache *cache;
+    const uint32_t *shift;
+};
+
+// one thread's share of the layouts, their engines packed in its arena
+struct LayoutGroup {
+    Arena arena;
+    vector<Layout> layouts;
+};
+
+void runGroup(const vector<Layout> &group, span<const TraceRecord> records,
+              const vector<uint16_t> &regionOf) {
+    for (size_t start = 0; start < records.size(); start += TILE) {
+        size_t end = min(records.size(), start + TILE);
+        for (const Layout &layout : group) {
+            for (size_t i = start; i < end; i++) {
+                TraceRecord rec = records[i];
+                rec.addr += layout.shift[regionOf[i]];
+                layout.cache->access(rec);
+            }
+        }
+    }
+    for (const Layout &layout : group) {
+        layout.cache->finish();
+    }
+}
+
+// nearest-rank percentile of sorted values
+double percentile(const vector<double> &sorted, double p) {
+    size_t rank = (size_t) ceil(p * sorted.size());
+    return sorted[rank == 0 ? 0 : rank - 1];
+}
+
+// whole numbers (cycles) are printed as such rather than in e-notation
+void printSpread(const string &name, vector<double> values, double original, bool whole,
+                 ostream &out) {
+    sort(values.begin(), values.end());
+    double sum = 0, squares = 0;
+    for (double v : values) {
+        sum += v;
+        squares += v * v;
+    }
+    double mean = sum / values.size();
+    double below = lower_bound(values.begin(), values.end(), original) - values.begin();
+    if (whole) {
+        out << fixed << setprecision(0);
+    }
+    out << "Layout " << name << " min: " << values.front() << "\n";
+    out << "Layout " << name << " p10: " << percentile(values, 0.10) << "\n";
+    out << "Layout " << name << " median: " << percentile(values, 0.50) << "\n";
+    out << "Layout " << name << " p90: " << percentile(values, 0.90) << "\n";
+    out << "Layout " << name << " max: " << values.back() << "\n";
+    out << "Layout " << name << " mean: " << mean << "\n";
+    out << "Layout " << name << " stddev: " << sqrt(max(0.0, squares / values.size() - mean * mean))
+        << "\n";
+    out << defaultfloat << setprecision(6);
+    // share of the layouts that did better than the trace's own
+    out << "Layout " << name << " original percentile: " << below / values.size() << "\n";
+}
+
+}
+
+LayoutResults runLayouts(const CacheConfig &cache, span<const TraceRecord> records,
+                         const LayoutConfig &config) {
+    LayoutResults results;
+    vector<uint16_t> regionOf;
+    vector<uint32_t> room;
+    results.regions = findRegions(records, regionOf, room);
+
+    // a region moves less rather than wrapping around to 0 or running into
+    // the next region, which makes room by moving up too. the regions of a
+    // layout are placed from the top down, but draw their numbers in order
+    uint64_t state = config.seed;
+    vector<uint64_t> draws((size_t) config.count * results.regions);
+    for (uint64_t &draw : draws) {
+        draw = splitmix(state);
+    }
+    vector<uint32_t> shifts(draws.size());
+    for (size_t k = 0; k < config.count; k++) {
+        size_t first = k * results.regions;
+        uint64_t above = 0; // pages the next region moved
+        for (size_t r = results.regions; r-- > 0;) {
+            uint64_t pages = min<uint64_t>(config.maxPages, room[r] + above);
+            above = draws[first + r] % (pages + 1);
+            shifts[first + r] = (uint32_t) (above << PAGE_BITS);
+        }
+    }
+
+    unique_ptr<ThreadPool> pool;
+    if (config.threads != 1) {
+        pool.reset(new ThreadPool(config.threads, config.pin));
+    }
+    unsigned threads = pool ? min(pool->size(), max(config.count, 1u)) : 1;
+
+    // every engine is built before the run, round robin over the threads,
+    // each in its thread's arena
+    vector<unique_ptr<LayoutGroup>> groups;
+    for (unsigned t = 0; t < threads; t++) {
+        groups.emplace_back(new LayoutGroup);
+    }
+    vector<Cache *> engines;
+    // the engines go before their arenas
+    auto destroyEngines = [&engines] {
+        for (Cache *engine : engines) {
+            engine->~Cache();
+        }
+    };
+    try {
+        for (unsigned k = 0; k < config.count; k++) {
+            LayoutGroup &group = *groups[k % threads];
+            void *mem = group.arena.allocate(sizeof(Cache), alignof(Cache));
+            Cache *engine = new (mem) Cache(cache, group.arena);
+            engines.push_back(engine);
+            group.layouts.push_back(Layout{engine, shifts.data() + (size_t) k * results.regions});
+        }
+
+        // threaded runs allocate inside the pool, so only single-threaded
+        // runs are audited
+        if (!pool) {
+            auditWarm();
+            runGroup(groups[0]->layouts, records, regionOf);
+            auditDone();
+        } else {
+            for (const unique_ptr<LayoutGroup> &group : groups) {
+                const vector<Layout> *g = &group->layouts;
+                pool->submit([g, &records, &regionOf] { runGroup(*g, records, regionOf); });
+            }
+            pool->wait();
+            results.pool = pool->stats();
+        }
+    } catch (...) {
+        destroyEngines();
+        throw;
+    }
+    for (Cache *engine : engines) {
+        results.runs.push_back(engine->stats());
+    }
+    destroyEngines();
+    return results;
+}
+
+void printLayouts(const CacheStats &original, const LayoutResults &results, ostream &out) {
+    out << "Layouts: " << results.runs.size() << "\n";
+    out << "Layout regions: " << results.regions << "\n";
+    if (results.runs.empty()) {
+        return;
+    }
+    auto missRate = [](const CacheStats &s) {
+        unsigned long accesses = s.totalLoads + s.totalStores;
+        return accesses ? (double) (s.loadMisses + s.storeMisses) / accesses : 0.0;
+    };
+    vector<double> rates, cycles;
+    for (const CacheStats &s : results.runs) {
+        rates.push_back(missRate(s));
+        cycles.push_back((double) s.cycles);
+    }
+    printSpread("miss rate", rates, missRate(original), false, out);
+    printSpread("cycles", cycles, (double) original.cycles, true, out);
+}
@@ -0,0 +1,44 @@
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+#include <cstdint>
+#include <ostream>
+#include <span>
+#include <vector>
+#include "cache.h"
+#include "thread_pool.h"
+#include "trace.h"
+
+// how to replay a trace under randomized address layouts
+struct LayoutConfig {
+    unsigned count = 0; // layouts to try
+    uint64_t seed = 1;
+    unsigned maxPages = 256; // each region moves by 0 to maxPages pages
+    unsigned threads = 0; // 0 for one per core
+    Pinning pin = Pinning::NONE;
+};
+
+// what came out of the layouts
+struct LayoutResults {
+    unsigned regions = 0;
+    std::vector<CacheStats> runs;
+    ThreadPool::Stats pool; // idle and contention of the threads, if any
+};
+
+// replay the trace under config.count layouts, each shifting every region of
+// the address space (runs of pages with less than 1MB between them, so the
+// stack, heap and mmap areas each end up in their own) by its own random
+// whole number of pages, the way ASLR and the allocator move things between
+// runs (never past the top of the 32-bit address space). every layout gets
+// its own engine, and the engines are split across threads that each walk
+// the one decoded trace tile by tile. throws std::invalid_argument like the
+// Cache constructor, and passes on what an engine throws while it runs, from
+// whichever thread
+LayoutResults runLayouts(const CacheConfig &cache, std::span<const TraceRecord> records,
+                         const LayoutConfig &config);
+
+// the spread of miss rates and cycles over the layouts, and where the trace's
+// own layout falls in it
+void printLayouts(const CacheStats &original, const LayoutResults &results, std::ostream &out);
+
+#endif
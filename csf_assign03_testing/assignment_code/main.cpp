@@ -1,206 +1,508 @@
+#include <deque>
+#include <fstream>
 #include <iostream>
+#include <sstream>
+#include <memory>
+#include <span>
+#include <stdexcept>
 #include <vector>
-#include <cmath>
 #include <string>
-#include <climits>
+#include "audit.h"
+#include "banks.h"
+#include "bus.h"
+#include "cache.h"
+#include "dram_cache.h"
+#include "layout.h"
+#include "options.h"
+#include "policy.h"
+#include "power.h"
+#include "results.h"
+#include "reuse.h"
+#include "shared_trace.h"
+#include "sweep.h"
+#include "throttle.h"
+#include "trace.h"
 
 using namespace std;
 
-// cache's single block
-struct CacheLine {
-    bool valid = false; // does line contain valid data
-    bool dirty = false; // dirty block or not
-    unsigned int tag = 0; // tag bits so we know which memory block stored
-    unsigned long lastUsed = 0; // used for LRU tracking
-};
-
 bool isPowerOfTwo(int n) {
     return (n > 0) && ((n & (n - 1)) == 0);
 }
 
-int main(int argc, char **argv) {
-    // program should have 6 arguments and the program name
-    if (argc != 7) {
-        cerr << "Usage: ./csim <num_sets> <blocks_per_set> <block_size> <write-allocate|no-write-allocate> <write-through|write-back> <lru|fifo>\n";
-        return 1;
-    }
+// csim_report_fn that prints "name: value" lines like the summary below
+void printStat(void *out, const char *name, double value) {
+    *static_cast<ostream *>(out) << name << ": " << value << "\n";
+}
+
+// engines built in an arena only need their destructor run, before the
+// arena goes
+struct DestroyInArena {
+    void operator()(Cache *cache) const { cache->~Cache(); }
+};
 
+// a new engine in the arena
+Cache *newCache(const CacheConfig &config, Arena &arena) {
+    void *mem = arena.allocate(sizeof(Cache), alignof(Cache));
+    return new (mem) Cache(config, arena);
+}
+
+// validate the six positional arguments and turn them into the engine's
+// config. the policy's args string lives in policies, which never moves its
+// elements, so config.policyArgs stays valid
+bool buildConfig(const vector<string> &args, deque<PolicySpec> &policies, CacheConfig &config,
+                 string &error) {
     // var declarations for the command line args above
-    int numSets = stoi(argv[1]);
-    int blocksPerSet = stoi(argv[2]);
-    int blockSize = stoi(argv[3]);
-    string writeAlloc = argv[4];
-    string writePolicy = argv[5];
-    string evictPolicy = argv[6];
+    int numSets, blocksPerSet, blockSize;
+    try {
+        numSets = stoi(args[0]);
+        blocksPerSet = stoi(args[1]);
+        blockSize = stoi(args[2]);
+    } catch (const exception &) {
+        error = "size parameters must be numbers.";
+        return false;
+    }
+    const string &writeAlloc = args[3];
+    const string &writePolicy = args[4];
+    const string &evictPolicy = args[5];
 
     // here is our validation checking
     // using the following bit trick check for powers of two
     if (!isPowerOfTwo(numSets) || !isPowerOfTwo(blocksPerSet) || !isPowerOfTwo(blockSize)) {
-        cerr << "Error: all size parameters must be powers of 2.\n";
-        return 1;
+        error = "all size parameters must be powers of 2.";
+        return false;
     }
-    
+
     // since accesses are <= 4 bytes, block size >= 4 bytes check
     if (blockSize < 4) {
-        cerr << "Error: block size must be >= 4 bytes.\n";
-        return 1;
+        error = "block size must be >= 4 bytes.";
+        return false;
     }
-    
+
     // when write-back combined with no-write-allocate this is an illegal configuration, check
     if (writeAlloc == "no-write-allocate" && writePolicy == "write-back") {
-        cerr << "Error: no-write-allocate cannot be used with write-back.\n";
+        error = "no-write-allocate cannot be used with write-back.";
+        return false;
+    }
+
+    // take the configuration strings and turn into the engine's config
+    config.numSets = numSets;
+    config.blocksPerSet = blocksPerSet;
+    config.blockSize = blockSize;
+    config.writeAllocate = (writeAlloc == "write-allocate");
+    config.writeBack = (writePolicy == "write-back");
+
+    // built-in policy name or a plugin to dlopen
+    policies.emplace_back();
+    if (!loadPolicy(evictPolicy, policies.back(), error)) {
+        return false;
+    }
+    config.policy = policies.back().policy;
+    config.policyArgs = policies.back().args.c_str();
+    return true;
+}
+
+// one config per line of a --configs file, the same six arguments as the
+// command line. blank lines and lines starting with # are skipped. every
+// config starts as a copy of base so it shares the non-positional options
+bool readConfigs(const string &path, const CacheConfig &base, deque<PolicySpec> &policies,
+                 vector<CacheConfig> &configs, string &error) {
+    ifstream in(path);
+    if (!in) {
+        error = "could not open " + path;
+        return false;
+    }
+    string line;
+    for (unsigned number = 1; getline(in, line); number++) {
+        istringstream words(line);
+        vector<string> args;
+        string word;
+        while (words >> word) {
+            args.push_back(word);
+        }
+        if (args.empty() || args[0][0] == '#') {
+            continue;
+        }
+        CacheConfig config = base;
+        if (args.size() != 6) {
+            error = "six values expected";
+        } else if (buildConfig(args, policies, config, error)) {
+            configs.push_back(config);
+            continue;
+        }
+        error = path + " line " + to_string(number) + ": " + error;
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    // program should have 6 arguments and the program name, optionally
+    // followed by --name=value settings
+    if (argc < 7) {
+        cerr << "Usage: ./csim <num_sets> <blocks_per_set> <block_size> <write-allocate|no-write-allocate> <write-through|write-back> <lru|fifo|perceptron[:args]|hawkeye[:args]|path/to/policy.so[:args]> [--option=value ...]\n";
+        return 1;
+    }
+    Options opts;
+    string error;
+    if (!opts.parse(argc, argv, 7, error)) {
+        cerr << "Error: " << error << "\n";
+        return 1;
+    }
+
+    // the six positional arguments make the first (usually only) config
+    deque<PolicySpec> policies;
+    CacheConfig config;
+    if (!buildConfig(vector<string>(argv + 1, argv + 7), policies, config, error)) {
+        cerr << "Error: " << error << "\n";
+        return 1;
+    }
+    unsigned blockSize = config.blockSize;
+
+    // prefetchers to attach, built in the arena once the engine is set up
+    PrefetchConfig pfConfig;
+    pfConfig.blockSize = blockSize;
+    vector<string> pfNames;
+    if (!parsePrefetchOptions(opts, pfConfig, pfNames, error)) {
+        cerr << "Error: " << error << "\n";
+        return 1;
+    }
+
+    // interval stats and the prefetch throttle that runs on them
+    unsigned long interval;
+    if (!opts.getUnsigned("interval", 10000, interval, error)) {
+        cerr << "Error: " << error << "\n";
+        return 1;
+    }
+    bool throttle = opts.has("throttle");
+    if (throttle && (pfNames.empty() || interval == 0)) {
+        cerr << "Error: --throttle needs --prefetch and a non-zero --interval.\n";
+        return 1;
+    }
+
+    // partial tags, approximate or as a study of a partial-tag design
+    unsigned long partialTagBits;
+    if (!opts.getUnsigned("partial-tags", 0, partialTagBits, error)) {
+        cerr << "Error: " << error << "\n";
+        return 1;
+    }
+    if (partialTagBits > 16 || (partialTagBits == 0 && opts.has("partial-tags"))) {
+        cerr << "Error: --partial-tags must be between 1 and 16 bits.\n";
+        return 1;
+    }
+    bool partialTagStudy = opts.has("partial-tag-study");
+    if (partialTagStudy && partialTagBits == 0) {
+        cerr << "Error: --partial-tag-study needs --partial-tags.\n";
         return 1;
     }
+    config.partialTagBits = partialTagBits;
+    config.partialTagStudy = partialTagStudy;
 
-    // take the configuration strings and turn into boolean flags
-    bool isWriteAlloc = (writeAlloc == "write-allocate");
-    bool useLRU = (evictPolicy == "lru");
+    // fingerprints in front of the full tags, same results with fewer tag reads
+    config.tagFilter = opts.has("tag-filter");
+    if (config.tagFilter && partialTagBits != 0) {
+        cerr << "Error: --tag-filter cannot be combined with --partial-tags.\n";
+        return 1;
+    }
 
-    // Initialize cache
-    // make a 2d vector cache here dependent on numSets and blocksPerSet
-    vector<vector<CacheLine>> cache(numSets, vector<CacheLine>(blocksPerSet));
+    // an optional DRAM cache between the cache and memory
+    DramConfig dramConfig;
+    if (!parseDramOptions(opts, blockSize, dramConfig, error)) {
+        cerr << "Error: " << error << "\n";
+        return 1;
+    }
+    // approximate partial tags cannot tell the prefetchers or the DRAM cache
+    // which block an eviction threw out
+    if (partialTagBits != 0 && !partialTagStudy && (!pfNames.empty() || dramConfig.sizeKB != 0)) {
+        cerr << "Error: --partial-tags without --partial-tag-study cannot be combined with "
+                "--prefetch or --dram-cache.\n";
+        return 1;
+    }
 
-    // counters for the to-be-calculated statistics
-    unsigned long totalLoads = 0;
-    unsigned long totalStores = 0;
-    unsigned long loadHits = 0;
-    unsigned long loadMisses = 0;
-    unsigned long storeHits = 0;
-    unsigned long storeMisses = 0;
-    unsigned long cycles = 0;
-    unsigned long timeCounter = 0; // this increments after an access
+    // bus width, latency and burst rate for fills from memory
+    if (!parseBusOptions(opts, config.bus, error)) {
+        cerr << "Error: " << error << "\n";
+        return 1;
+    }
+    if (config.bus.width != 0 && dramConfig.sizeKB != 0) {
+        cerr << "Error: --bus-width cannot be combined with --dram-cache.\n";
+        return 1;
+    }
 
-    string op;
-    unsigned int addr;
-    unsigned int dummy;
+    // L1 banks and ports for accesses issued in the same cycle
+    if (!parseBankOptions(opts, config.banks, error)) {
+        cerr << "Error: " << error << "\n";
+        return 1;
+    }
+
+    // ways or sets switched off, or lines put to sleep, on interval feedback
+    string power = opts.get("power", "");
+    unsigned long powerSlack;
+    if (!opts.getUnsigned("power-slack", 10, powerSlack, error)) {
+        cerr << "Error: " << error << "\n";
+        return 1;
+    }
+    PowerConfig powerConfig;
+    powerConfig.slack = powerSlack / 100.0;
+    if (power == "ways") {
+        powerConfig.mode = PowerMode::WAYS;
+    } else if (power == "sets") {
+        powerConfig.mode = PowerMode::SETS;
+    } else if (power == "drowsy") {
+        powerConfig.mode = PowerMode::DROWSY;
+    } else if (!power.empty()) {
+        cerr << "Error: --power must be ways, sets or drowsy.\n";
+        return 1;
+    }
+    if (!power.empty() && (interval == 0 || !pfNames.empty() || partialTagBits != 0)) {
+        cerr << "Error: --power needs a non-zero --interval and cannot be combined with --prefetch "
+                "or --partial-tags.\n";
+        return 1;
+    }
+    if (opts.has("power-slack") && power.empty()) {
+        cerr << "Error: --power-slack needs --power.\n";
+        return 1;
+    }
+
+    // the same cache again under randomized region layouts
+    LayoutConfig layoutConfig;
+    unsigned long layouts, layoutSeed, layoutPages, layoutThreads;
+    if (!opts.getUnsigned("aslr", 0, layouts, error) ||
+        !opts.getUnsigned("aslr-seed", layoutConfig.seed, layoutSeed, error) ||
+        !opts.getUnsigned("aslr-pages", layoutConfig.maxPages, layoutPages, error) ||
+        !opts.getUnsigned("aslr-threads", layoutConfig.threads, layoutThreads, error)) {
+        cerr << "Error: " << error << "\n";
+        return 1;
+    }
+    if (layouts == 0 && (opts.has("aslr-seed") || opts.has("aslr-pages") || opts.has("aslr-threads"))) {
+        cerr << "Error: --aslr-seed, --aslr-pages and --aslr-threads need --aslr.\n";
+        return 1;
+    }
+    if (layouts != 0 && (!pfNames.empty() || dramConfig.sizeKB != 0 || !power.empty())) {
+        cerr << "Error: --aslr cannot be combined with --prefetch, --dram-cache or --power.\n";
+        return 1;
+    }
+    if (layoutPages > (1ul << 20)) {
+        cerr << "Error: --aslr-pages can be at most 1048576.\n";
+        return 1;
+    }
+    layoutConfig.count = layouts;
+    layoutConfig.seed = layoutSeed;
+    layoutConfig.maxPages = layoutPages;
+    layoutConfig.threads = layoutThreads;
+
+    // exact reuse distances of the trace's blocks, profiled in chunks
+    bool reuse = opts.has("reuse-distance");
+    ReuseConfig reuseConfig;
+    unsigned long reuseThreads, reuseChunks;
+    if (!opts.getUnsigned("reuse-threads", reuseConfig.threads, reuseThreads, error) ||
+        !opts.getUnsigned("reuse-chunks", reuseConfig.chunks, reuseChunks, error)) {
+        cerr << "Error: " << error << "\n";
+        return 1;
+    }
+    if (!reuse && (opts.has("reuse-threads") || opts.has("reuse-chunks"))) {
+        cerr << "Error: --reuse-threads and --reuse-chunks need --reuse-distance.\n";
+        return 1;
+    }
+    reuseConfig.blockSize = blockSize;
+    reuseConfig.threads = reuseThreads;
+    reuseConfig.chunks = reuseChunks;
+
+    // every block size from 4 to 512 bytes at once instead of argv[3], or the
+    // configs of a file next to the one on the command line, run as one sweep
+    string sweep = opts.get("block-sweep", "");
+    string configFile = opts.get("configs", "");
+    if (!sweep.empty() && sweep != "capacity" && sweep != "sets") {
+        cerr << "Error: --block-sweep must be capacity or sets.\n";
+        return 1;
+    }
+    bool sweeping = !sweep.empty() || !configFile.empty();
+    if (!sweep.empty() && !configFile.empty()) {
+        cerr << "Error: --block-sweep and --configs cannot be combined.\n";
+        return 1;
+    }
+    if (sweeping &&
+        (!pfNames.empty() || dramConfig.sizeKB != 0 || !power.empty() || layouts != 0 || reuse)) {
+        cerr << "Error: --block-sweep and --configs cannot be combined with --prefetch, --dram-cache, "
+                "--power, --aslr or --reuse-distance.\n";
+        return 1;
+    }
+    unsigned long sweepThreads;
+    if (!opts.getUnsigned("sweep-threads", 1, sweepThreads, error)) {
+        cerr << "Error: " << error << "\n";
+        return 1;
+    }
+    // every config of the sweep as a coroutine, for thousands of tiny ones
+    bool coroutines = opts.has("sweep-coroutines");
+    if ((opts.has("sweep-threads") || coroutines) && !sweeping) {
+        cerr << "Error: --sweep-threads and --sweep-coroutines need --block-sweep or --configs.\n";
+        return 1;
+    }
+    // sweep results as a columnar file for csim-query, tagged with the trace
+    string resultsFile = opts.get("results", "");
+    string traceName = opts.get("trace-name", "stdin");
+    if ((!resultsFile.empty() || opts.has("trace-name")) && !sweeping) {
+        cerr << "Error: --results and --trace-name need --block-sweep or --configs.\n";
+        return 1;
+    }
+    vector<CacheConfig> sweepConfigs;
+    if (!sweep.empty()) {
+        sweepConfigs = blockSweepConfigs(config, sweep == "capacity" ? SweepMode::CAPACITY : SweepMode::SETS);
+    } else if (!configFile.empty()) {
+        sweepConfigs.push_back(config);
+        if (!readConfigs(configFile, config, policies, sweepConfigs, error)) {
+            cerr << "Error: " << error << "\n";
+            return 1;
+        }
+    }
+
+    // decoded records shared with every other csim on the same trace
+    bool sharedTrace = opts.has("shared-trace");
+
+    if (!opts.firstUnused().empty()) {
+        cerr << "Error: unknown option --" << opts.firstUnused() << "\n";
+        return 1;
+    }
 
     // read the memory trace with stdin
-    // lines have form <op> <hex address> <ignored field>
-    while (cin >> op >> std::hex >> addr >> dummy) {
-        // bit manipulation to calc the index and tag
-        unsigned int blockOffsetBits = log2(blockSize);
-        unsigned int setBits = log2(numSets);
-        unsigned int setIndex = (addr >> blockOffsetBits) & ((1 << setBits) - 1);
-        unsigned int tag = addr >> (blockOffsetBits + setBits);
-
-        vector<CacheLine> &set = cache[setIndex];
-        bool hit = false;
-        int hitIndex = -1; // to track which line is hit
-        int emptyIndex = -1; // here to track first empty slot
-        int evictIndex = 0; // if full then this is index of to-be-evicted block
-        unsigned long oldestTime = ULONG_MAX; // use for finding most recently used block
-
-        // iterate and search for hit or even possible victim line for eviction
-        for (int i = 0; i < blocksPerSet; i++) {
-            // cache hits
-            if (set[i].valid && set[i].tag == tag) { 
-                hit = true;
-                /*if (useLRU) {
-                    set[i].lastUsed = timeCounter; // update the recency
-                } */
-                hitIndex = i;
-                break;
-            }
-            
-            // keep track of first empty line
-            if (!set[i].valid && emptyIndex == -1) {
-                emptyIndex = i;
+    // lines have form <op> <hex address> <gap>
+    vector<TraceRecord> decoded;
+    SharedTrace shared;
+    span<const TraceRecord> records;
+    if (sharedTrace) {
+        if (!shared.open(stdin, error)) {
+            cerr << "Error: " << error << "\n";
+            return 1;
+        }
+        records = shared.records();
+    } else {
+        if (!readTrace(stdin, decoded, error)) {
+            cerr << "Error: stdin: " << error << "\n";
+            return 1;
+        }
+        records = decoded;
+    }
+
+    if (sweeping) {
+        vector<SweepRow> rows;
+        SweepTiming timing;
+        try {
+            timing = runSweep(sweepConfigs, records, sweepThreads,
+                              coroutines ? SweepExecutor::COROUTINES : SweepExecutor::TILES, rows);
+        } catch (const exception &e) {
+            cerr << "Error: " << e.what() << "\n";
+            return 1;
+        }
+        printSweep(rows, timing, records.size(), cout);
+        if (!resultsFile.empty()) {
+            ResultsWriter results;
+            for (const SweepRow &row : rows) {
+                results.add(traceName, row.config, row.stats);
             }
-            
-            // for LRU eviction below helps by tracking oldest line 
-            if (set[i].lastUsed < oldestTime) {
-                oldestTime = set[i].lastUsed;
-                evictIndex = i;
+            if (!results.write(resultsFile, error)) {
+                cerr << "Error: " << error << "\n";
+                return 1;
             }
         }
-        timeCounter++; // timestamp has to increment for next access
-
-        // code to handle the load operation
-        if (op == "l") {
-            totalLoads++;
-            if (hit) {
-                loadHits++;
-                cycles += 1; // cache hit so you add a cycle
-                if (useLRU) {
-                    set[hitIndex].lastUsed = timeCounter;
-                }
-            } else {
-                loadMisses++;
-                cycles += 100 * (blockSize / 4) + 1; // cache miss so get block from memory
-
-                // take this block just retrieved and insert into cache
-                int target;
-                if (emptyIndex != -1) {
-                    target = emptyIndex;
-                } else {
-                    target = evictIndex;
-                    if (writePolicy == "write-back" && set[evictIndex].dirty) {
-                        cycles += 100 * (blockSize / 4); // write back dirty block
-                    }
-                }
-
-                set[target].valid = true;
-                set[target].tag = tag;
-                set[target].lastUsed = timeCounter;
-                set[target].dirty = false;
-            }
-        } else if (op == "s") {
-            totalStores++;
-            if (hit) {
-                storeHits++;
-                if (writePolicy == "write-through") {
-                    cycles += 1 + 100; // write cache and memory
-                } else {
-                    cycles += 1; // cache hit so you add a cycle
-                    set[hitIndex].dirty = true; // mark dirty on write-back hit
-                }
-                if (useLRU) {
-                    set[hitIndex].lastUsed = timeCounter;
-                }
-            } else {
-                storeMisses++;
-                if (isWriteAlloc) {
-                    cycles += 100 * (blockSize / 4); // cache miss so get block from memory
-
-                    // take this block just retrieved and insert into cache
-                    int target;
-                    if (emptyIndex != -1) {
-                        target = emptyIndex;
-                    } else {
-                        target = evictIndex;
-                        if (writePolicy == "write-back" && set[evictIndex].dirty) {
-                            cycles += 100 * (blockSize / 4); // this is write-back eviction penalty
-                        }
-                    }
-
-                    set[target].valid = true;
-                    set[target].tag = tag;
-                    set[target].lastUsed = timeCounter;
-
-                    // write depending on policy
-                    if (writePolicy == "write-through") {
-                        cycles += 1 + 100;
-                        set[target].dirty = false;
-                    } else {
-                        cycles += 1;
-                        set[target].dirty = true;
-                    }
-                } else {
-                    // no-write-allocate so write directly to memory
-                    cycles += 100;
-                }
+        return 0;
+    }
+
+    // Initialize cache, all of its state comes out of the arena
+    Arena arena;
+    unique_ptr<Cache, DestroyInArena> cache;
+    vector<Prefetcher *> prefetchers;
+    for (const string &name : pfNames) {
+        prefetchers.push_back(makePrefetcher(name, pfConfig, arena));
+    }
+    config.prefetchers = prefetchers.data();
+    config.numPrefetchers = prefetchers.size();
+    vector<IntervalObserver *> observers;
+    PrefetchThrottle *throttler = nullptr;
+    if (throttle) {
+        void *mem = arena.allocate(sizeof(PrefetchThrottle), alignof(PrefetchThrottle));
+        throttler = new (mem) PrefetchThrottle(prefetchers.data(), prefetchers.size(),
+                                               records.size() / interval + 1, arena);
+        observers.push_back(throttler);
+        config.throttle = throttler;
+    }
+    DramCache *dram = nullptr;
+    if (dramConfig.sizeKB != 0) {
+        void *mem = arena.allocate(sizeof(DramCache), alignof(DramCache));
+        dram = new (mem) DramCache(dramConfig, arena);
+        config.lower = dram;
+    }
+    // power management also runs the plain cache next to it, for the misses
+    // and cycles it costs
+    CacheConfig plainConfig = config;
+    PowerManager *powerManager = nullptr;
+    unique_ptr<Cache, DestroyInArena> reference;
+    if (!power.empty()) {
+        void *mem = arena.allocate(sizeof(PowerManager), alignof(PowerManager));
+        powerManager = new (mem) PowerManager(powerConfig, config,
+                                              (records.size() + interval - 1) / interval, arena);
+        observers.push_back(powerManager);
+        config.powerManaged = true;
+        if (dram != nullptr) {
+            mem = arena.allocate(sizeof(DramCache), alignof(DramCache));
+            plainConfig.lower = new (mem) DramCache(dramConfig, arena);
+        }
+    }
+    config.interval = observers.empty() ? 0 : interval;
+    config.observers = observers.data();
+    config.numObservers = observers.size();
+    try {
+        cache.reset(newCache(config, arena));
+        if (powerManager != nullptr) {
+            reference.reset(newCache(plainConfig, arena));
+        }
+
+        // everything is set up now, nothing below this point may allocate
+        auditWarm();
+        for (const TraceRecord &rec : records) {
+            cache->access(rec);
+        }
+        cache->finish();
+        if (reference != nullptr) {
+            for (const TraceRecord &rec : records) {
+                reference->access(rec);
             }
+            reference->finish();
         }
+        auditDone();
+    } catch (const exception &e) {
+        cerr << "Error: " << e.what() << "\n";
+        return 1;
     }
 
     // simply output the summary statistics calculated above
-    cout << "Total loads: " << totalLoads << "\n";
-    cout << "Total stores: " << totalStores << "\n";
-    cout << "Load hits: " << loadHits << "\n";
-    cout << "Load misses: " << loadMisses << "\n";
-    cout << "Store hits: " << storeHits << "\n";
-    cout << "Store misses: " << storeMisses << "\n";
-    cout << "Total cycles: " << cycles << "\n";
+    writeSummary(cache->stats(), cout);
+    cache->reportPolicy(printStat, &cout);
+    cache->reportPrefetch(printStat, &cout);
+    cache->reportPartialTags(printStat, &cout);
+    cache->reportBus(printStat, &cout);
+    cache->reportTagFilter(printStat, &cout);
+    cache->reportBanks(printStat, &cout);
+    if (dram != nullptr) {
+        dram->report(printStat, &cout);
+    }
+    if (throttler != nullptr) {
+        throttler->report(cout);
+    }
+    if (powerManager != nullptr) {
+        powerManager->report(*cache, reference->stats(), cout);
+    }
+    if (layouts != 0) {
+        LayoutResults results;
+        try {
+            results = runLayouts(plainConfig, records, layoutConfig);
+        } catch (const exception &e) {
+            cerr << "Error: " << e.what() << "\n";
+            return 1;
+        }
+        printLayouts(cache->stats(), results, cout);
+    }
+    if (reuse) {
+        printReuse(reuseDistances(records, reuseConfig), cout);
+    }
 
     return 0;
 }
@@ -0,0 +1,78 @@
+// malloc interposer for the audit build (make audit). it forwards everything to
+// glibc but counts every allocation made between csim_audit_warm() and
+// csim_audit_done(), and exits with a failure if there were any
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t n, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void *__libc_memalign(size_t align, size_t size);
+}
+
+namespace {
+volatile bool armed = false;
+volatile unsigned long lateAllocs = 0;
+
+inline void note() {
+    if (armed) {
+        lateAllocs = lateAllocs + 1;
+    }
+}
+}
+
+extern "C" {
+
+void *malloc(size_t size) {
+    note();
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size) {
+    note();
+    return __libc_calloc(n, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    note();
+    return __libc_realloc(ptr, size);
+}
+
+void *memalign(size_t align, size_t size) {
+    note();
+    return __libc_memalign(align, size);
+}
+
+void *aligned_alloc(size_t align, size_t size) {
+    note();
+    return __libc_memalign(align, size);
+}
+
+int posix_memalign(void **out, size_t align, size_t size) {
+    note();
+    void *p = __libc_memalign(align, size);
+    if (p == nullptr) {
+        return ENOMEM;
+    }
+    *out = p;
+    return 0;
+}
+
+void csim_audit_warm() {
+    lateAllocs = 0;
+    armed = true;
+}
+
+void csim_audit_done() {
+    armed = false;
+    if (lateAllocs != 0) {
+        fprintf(stderr, "malloc audit: %lu allocation(s) after warm-up\n", (unsigned long) lateAllocs);
+        _exit(1);
+    }
+    fprintf(stderr, "malloc audit: no allocations after warm-up\n");
+}
+
+}
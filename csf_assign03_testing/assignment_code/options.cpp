@@ -0,0 +1,66 @@
+#include <cstdlib>
+#include "options.h"
+
+using namespace std;
+
+bool Options::parse(int argc, char **argv, int first, string &error) {
+    for (int i = first; i < argc; i++) {
+        string arg = argv[i];
+        if (arg.size() < 3 || arg.compare(0, 2, "--") != 0) {
+            error = "expected --name=value but got '" + arg + "'";
+            return false;
+        }
+        size_t eq = arg.find('=');
+        if (eq == string::npos) {
+            values[arg.substr(2)].text = "";
+        } else {
+            values[arg.substr(2, eq - 2)].text = arg.substr(eq + 1);
+        }
+    }
+    return true;
+}
+
+bool Options::has(const string &name) {
+    auto it = values.find(name);
+    if (it == values.end()) {
+        return false;
+    }
+    it->second.used = true;
+    return true;
+}
+
+string Options::get(const string &name, const string &fallback) {
+    auto it = values.find(name);
+    if (it == values.end()) {
+        return fallback;
+    }
+    it->second.used = true;
+    return it->second.text;
+}
+
+bool Options::getUnsigned(const string &name, unsigned long fallback, unsigned long &value,
+                          string &error) {
+    auto it = values.find(name);
+    if (it == values.end()) {
+        value = fallback;
+        return true;
+    }
+    it->second.used = true;
+    const string &text = it->second.text;
+    char *end = nullptr;
+    value = strtoul(text.c_str(), &end, 0);
+    if (text.empty() || *end != '\0' || text[0] == '-') {
+        error = "--" + name + " needs a whole number, got '" + text + "'";
+        return false;
+    }
+    return true;
+}
+
+string Options::firstUnused() const {
+    for (const auto &entry : values) {
+        if (!entry.second.used) {
+            return entry.first;
+        }
+    }
+    return "";
+}
@@ -0,0 +1,32 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include <map>
+#include <string>
+
+// the optional --name=value (or bare --name) settings that may follow the six
+// positional arguments. every getter marks the option as used so main can
+// reject anything nobody asked for
+class Options {
+public:
+    // parse argv[first..argc), returns false and sets error on a malformed option
+    bool parse(int argc, char **argv, int first, std::string &error);
+
+    bool has(const std::string &name);
+    std::string get(const std::string &name, const std::string &fallback);
+    // fails (returns false, sets error) if the value is not a whole number
+    bool getUnsigned(const std::string &name, unsigned long fallback, unsigned long &value,
+                     std::string &error);
+
+    // name of the first option that was given but never looked at, or ""
+    std::string firstUnused() const;
+
+private:
+    struct Value {
+        std::string text;
+        bool used = false;
+    };
+    std::map<std::string, Value> values;
+};
+
+#endif
@@ -0,0 +1,202 @@
+// hashed-perceptron reuse predictor (after Teran, Wang & Jimenez, MICRO 2016)
+// driving insertion priority and bypass on top of LRU: predicted-dead lines
+// are evicted first and confidently dead blocks are not cached at all. the
+// traces carry no PC, so the features are what a trace record does have: the
+// address at block, page and 64KB region granularity, the gap field and op
+// type, and the recent hit/miss history together with the page of the last
+// miss. each feature indexes its own table of 6-bit weights and the sum
+// predicts whether the block will be hit again before it is evicted
+#include <cstring>
+#include "policy.h"
+
+using namespace std;
+
+namespace {
+
+const unsigned FEATURES = 6;
+const unsigned TABLE_BITS = 8; // 256 weights per feature
+const int WEIGHT_MAX = 31;
+const int WEIGHT_MIN = -32;
+const int THETA = 24; // keep training until the sum is this confident
+const int DEAD_THRESHOLD = 8; // above: predicted dead, first in line for eviction
+const int BYPASS_THRESHOLD = 48; // above: do not cache at all
+const unsigned EXPLORE_EVERY = 32; // every n-th bypass is cached anyway to keep learning
+
+// per-line metadata
+struct LineMeta {
+    uint8_t index[FEATURES]; // feature table entries of the line's last access
+    uint8_t predictedDead; // prediction made at the last access
+    uint8_t pad;
+    uint32_t lastUsed; // lru stamp (low bits of the access counter)
+};
+
+struct Perceptron {
+    uint32_t ways;
+    uint32_t offsetBits; // log2 of the block size
+    bool allowBypass;
+    int8_t weights[FEATURES][1u << TABLE_BITS];
+    uint8_t history; // last 8 outcomes, 1 = miss
+    uint32_t lastMissPage;
+    // features of the block being placed, from choose_victim to on_fill
+    uint8_t pending[FEATURES];
+    int pendingSum;
+    unsigned bypassSeen;
+    // reporting
+    unsigned long predictions;
+    unsigned long correct;
+    unsigned long deadPredictions; // of those, lines predicted dead
+    unsigned long deadCorrect;
+    unsigned long bypasses;
+    unsigned long deadInserts;
+};
+
+uint8_t mix(uint32_t value, unsigned feature) {
+    uint32_t h = (value ^ (feature * 0x9e3779b9u)) * 0x85ebca6bu;
+    h ^= h >> 15;
+    return (uint8_t) (h >> (32 - TABLE_BITS));
+}
+
+void features(Perceptron *p, const csim_access *a, uint8_t *index) {
+    uint32_t gap = a->gap < 15 ? a->gap : 15;
+    index[0] = mix(a->addr >> p->offsetBits, 0);
+    index[1] = mix(a->addr >> 12, 1);
+    index[2] = mix(a->addr >> 16, 2);
+    index[3] = mix(gap << 1 | a->is_store, 3);
+    index[4] = mix(p->history, 4);
+    index[5] = mix((a->addr >> 12) ^ p->lastMissPage, 5);
+}
+
+int sum(const Perceptron *p, const uint8_t *index) {
+    int y = 0;
+    for (unsigned f = 0; f < FEATURES; f++) {
+        y += p->weights[f][index[f]];
+    }
+    return y;
+}
+
+// positive sums mean dead, so a reuse pushes the weights down
+void train(Perceptron *p, const LineMeta &m, bool reused) {
+    int y = sum(p, m.index);
+    p->predictions++;
+    if ((m.predictedDead != 0) != reused) {
+        p->correct++;
+    }
+    if (m.predictedDead != 0) {
+        p->deadPredictions++;
+        p->deadCorrect += !reused;
+    }
+    bool wrong = (y > DEAD_THRESHOLD) == reused;
+    if (!wrong && (y > THETA || y < -THETA)) {
+        return;
+    }
+    for (unsigned f = 0; f < FEATURES; f++) {
+        int8_t &w = p->weights[f][m.index[f]];
+        if (reused && w > WEIGHT_MIN) {
+            w--;
+        } else if (!reused && w < WEIGHT_MAX) {
+            w++;
+        }
+    }
+}
+
+void *perceptronCreate(const csim_policy_config *config) {
+    bool allowBypass = true;
+    if (strcmp(config->args, "nobypass") == 0) {
+        allowBypass = false;
+    } else if (config->args[0] != '\0') {
+        return nullptr;
+    }
+    Perceptron *p = static_cast<Perceptron *>(config->alloc(config->arena, sizeof(Perceptron),
+                                                            alignof(Perceptron)));
+    p->ways = config->ways;
+    p->allowBypass = allowBypass;
+    while ((1u << p->offsetBits) < config->block_size) {
+        p->offsetBits++;
+    }
+    return p;
+}
+
+LineMeta *lines(uint8_t *lineMeta) {
+    return reinterpret_cast<LineMeta *>(lineMeta);
+}
+
+void perceptronHit(void *ctx, const csim_access *access, uint8_t *, uint8_t *lineMeta, uint32_t way) {
+    Perceptron *p = static_cast<Perceptron *>(ctx);
+    LineMeta &m = lines(lineMeta)[way];
+    train(p, m, true);
+    p->history = (uint8_t) (p->history << 1);
+
+    // the hit becomes the line's new last access
+    features(p, access, m.index);
+    m.predictedDead = sum(p, m.index) > DEAD_THRESHOLD;
+    m.lastUsed = (uint32_t) access->now;
+}
+
+void perceptronHitBatch(void *ctx, const csim_hit *hits, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        perceptronHit(ctx, &hits[i].access, hits[i].set_meta, hits[i].line_meta, hits[i].way);
+    }
+}
+
+uint32_t perceptronVictim(void *ctx, const csim_access *access, uint8_t *, uint8_t *lineMeta,
+                          uint32_t firstInvalid) {
+    Perceptron *p = static_cast<Perceptron *>(ctx);
+    features(p, access, p->pending);
+    p->pendingSum = sum(p, p->pending);
+    p->history = (uint8_t) (p->history << 1 | 1);
+    p->lastMissPage = access->addr >> 12;
+
+    if (firstInvalid < p->ways) {
+        return firstInvalid;
+    }
+    if (p->allowBypass && p->pendingSum > BYPASS_THRESHOLD) {
+        if (++p->bypassSeen % EXPLORE_EVERY != 0) {
+            p->bypasses++;
+            return CSIM_POLICY_BYPASS;
+        }
+    }
+
+    // oldest predicted-dead line if there is one, plain lru otherwise
+    LineMeta *m = lines(lineMeta);
+    uint32_t victim = 0;
+    bool victimDead = false;
+    for (uint32_t i = 0; i < p->ways; i++) {
+        bool dead = m[i].predictedDead != 0;
+        if ((dead && !victimDead) || (dead == victimDead && m[i].lastUsed < m[victim].lastUsed)) {
+            victim = i;
+            victimDead = dead;
+        }
+    }
+    train(p, m[victim], false);
+    return victim;
+}
+
+void perceptronFill(void *ctx, const csim_access *access, uint8_t *, uint8_t *lineMeta, uint32_t way) {
+    Perceptron *p = static_cast<Perceptron *>(ctx);
+    LineMeta &m = lines(lineMeta)[way];
+    memcpy(m.index, p->pending, FEATURES);
+    m.predictedDead = p->pendingSum > DEAD_THRESHOLD;
+    m.lastUsed = (uint32_t) access->now;
+    if (m.predictedDead) {
+        p->deadInserts++;
+    }
+}
+
+void perceptronReport(void *ctx, csim_report_fn emit, void *out) {
+    Perceptron *p = static_cast<Perceptron *>(ctx);
+    emit(out, "Perceptron predictions", (double) p->predictions);
+    emit(out, "Perceptron accuracy", p->predictions ? (double) p->correct / p->predictions : 0.0);
+    emit(out, "Perceptron dead precision",
+         p->deadPredictions ? (double) p->deadCorrect / p->deadPredictions : 0.0);
+    emit(out, "Perceptron dead inserts", (double) p->deadInserts);
+    emit(out, "Perceptron bypasses", (double) p->bypasses);
+}
+
+}
+
+const csim_policy perceptronPolicy = {
+    CSIM_POLICY_ABI_VERSION, sizeof(LineMeta), 0, "perceptron",
+    perceptronCreate, nullptr, nullptr,
+    perceptronHit, perceptronFill, perceptronVictim,
+    perceptronHitBatch, perceptronReport
+};
@@ -0,0 +1,134 @@
+#include <cstddef>
+#include <cstring>
+#include <dlfcn.h>
+#include "policy.h"
+
+using namespace std;
+
+namespace {
+
+// lru and fifo both keep one timestamp per line, they only differ in whether
+// a hit refreshes it
+uint64_t &stamp(uint8_t *lineMeta, uint32_t way) {
+    return reinterpret_cast<uint64_t *>(lineMeta)[way];
+}
+
+void stampLine(void *, const csim_access *access, uint8_t *, uint8_t *lineMeta, uint32_t way) {
+    stamp(lineMeta, way) = access->now;
+}
+
+void keepStamp(void *, const csim_access *, uint8_t *, uint8_t *, uint32_t) {
+}
+
+// empty slot first, otherwise the line with the oldest timestamp
+uint32_t oldestLine(void *ctx, const csim_access *, uint8_t *, uint8_t *lineMeta, uint32_t firstInvalid) {
+    const csim_policy_config *config = static_cast<const csim_policy_config *>(ctx);
+    if (firstInvalid < config->ways) {
+        return firstInvalid;
+    }
+    uint32_t victim = 0;
+    for (uint32_t i = 1; i < config->ways; i++) {
+        if (stamp(lineMeta, i) < stamp(lineMeta, victim)) {
+            victim = i;
+        }
+    }
+    return victim;
+}
+
+// the context is just a copy of the config, the victim search needs the ways
+void *copyConfig(const csim_policy_config *config) {
+    void *ctx = config->alloc(config->arena, sizeof(csim_policy_config), alignof(csim_policy_config));
+    memcpy(ctx, config, sizeof(csim_policy_config));
+    return ctx;
+}
+
+const csim_policy lruPolicy = {
+    CSIM_POLICY_ABI_VERSION, sizeof(uint64_t), 0, "lru",
+    copyConfig, nullptr, nullptr,
+    stampLine, stampLine, oldestLine,
+    nullptr, nullptr
+};
+
+const csim_policy fifoPolicy = {
+    CSIM_POLICY_ABI_VERSION, sizeof(uint64_t), 0, "fifo",
+    copyConfig, nullptr, nullptr,
+    keepStamp, stampLine, oldestLine,
+    nullptr, nullptr
+};
+
+const csim_policy *const builtinPolicies[] = {
+    &lruPolicy,
+    &fifoPolicy,
+    &perceptronPolicy,
+    &hawkeyePolicy,
+};
+
+}
+
+const csim_policy *findBuiltinPolicy(const string &name) {
+    for (const csim_policy *policy : builtinPolicies) {
+        if (name == policy->name) {
+            return policy;
+        }
+    }
+    return nullptr;
+}
+
+bool loadPolicy(const string &text, PolicySpec &spec, string &error) {
+    string name = text;
+    size_t colon = text.find(':');
+    if (colon != string::npos) {
+        name = text.substr(0, colon);
+        spec.args = text.substr(colon + 1);
+    }
+
+    // anything that looks like a path is a plugin, the rest must be built in
+    bool isPlugin = name.find('/') != string::npos ||
+                    (name.size() > 3 && name.compare(name.size() - 3, 3, ".so") == 0);
+    if (!isPlugin) {
+        spec.policy = findBuiltinPolicy(name);
+        if (spec.policy == nullptr) {
+            error = "unknown replacement policy '" + name + "'";
+            return false;
+        }
+        return true;
+    }
+
+    // dlopen searches the library path for a bare file name, a plugin named
+    // without a directory is the one in the current directory
+    if (name.find('/') == string::npos) {
+        name = "./" + name;
+    }
+
+    // plugins stay loaded until the process exits
+    void *handle = dlopen(name.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (handle == nullptr) {
+        error = dlerror();
+        return false;
+    }
+    void *entry = dlsym(handle, CSIM_POLICY_ENTRY);
+    if (entry == nullptr) {
+        error = name + " does not export " CSIM_POLICY_ENTRY;
+        return false;
+    }
+    spec.policy = reinterpret_cast<csim_policy_entry_fn>(entry)();
+    if (spec.policy == nullptr || spec.policy->abi_version < CSIM_POLICY_ABI_VERSION_MIN ||
+        spec.policy->abi_version > CSIM_POLICY_ABI_VERSION) {
+        error = name + " was built for a different policy ABI version";
+        return false;
+    }
+    if (spec.policy->abi_version == 1) {
+        // the table stops before on_bypass, the engine gets a full copy that
+        // lives as long as the plugin
+        csim_policy *full = new csim_policy();
+        memcpy(full, spec.policy, offsetof(csim_policy, on_bypass));
+        full->abi_version = CSIM_POLICY_ABI_VERSION;
+        spec.policy = full;
+    }
+    if (spec.policy->on_hit == nullptr || spec.policy->on_fill == nullptr ||
+        spec.policy->choose_victim == nullptr) {
+        error = name + " is missing a required callback";
+        return false;
+    }
+    return true;
+}
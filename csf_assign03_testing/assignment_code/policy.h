@@ -0,0 +1,25 @@
+#ifndef POLICY_H
+#define POLICY_H
+
+#include <string>
+#include "csim_policy.h"
+
+// a resolved policy argument: the callback table plus its ":args" suffix
+struct PolicySpec {
+    const csim_policy *policy = nullptr;
+    std::string args;
+};
+
+// built-in policies that live in their own files
+extern const csim_policy perceptronPolicy; // perceptron_policy.cpp
+extern const csim_policy hawkeyePolicy; // hawkeye_policy.cpp
+
+// built-in policies by name, nullptr if there is no such policy
+const csim_policy *findBuiltinPolicy(const std::string &name);
+
+// resolve the policy argument, which is either a built-in name or the path of
+// a plugin .so, optionally followed by ":args". returns false and fills in
+// error if the policy cannot be found or loaded
+bool loadPolicy(const std::string &text, PolicySpec &spec, std::string &error);
+
+#endif
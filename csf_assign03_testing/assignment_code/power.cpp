@@ -0,0 +1,122 @@
+#include "power.h"
+
+using namespace std;
+
+PowerManager::PowerManager(const PowerConfig &config, const CacheConfig &cache,
+                           unsigned long maxIntervals, Arena &arena)
+    : cfg(config), maxIntervals(maxIntervals) {
+    ways = cache.blocksPerSet;
+    sets = cache.numSets;
+    lines = (size_t) ways * sets;
+    blockSize = cache.blockSize;
+    timeline = arena.make<uint32_t>(maxIntervals);
+}
+
+void PowerManager::intervalEnd(Cache &cache, unsigned long interval) {
+    (void) interval;
+    const CacheStats &st = cache.stats();
+    unsigned long accesses = st.totalLoads + st.totalStores - lastAccesses;
+    unsigned long misses = st.loadMisses + st.storeMisses - lastMisses;
+    unsigned long wakes = cache.drowsyWakes() - lastWakes;
+    lastAccesses += accesses;
+    lastMisses += misses;
+    lastWakes += wakes;
+    if (accesses == 0) {
+        return;
+    }
+
+    // what was switched on during the interval that just ended
+    double on;
+    if (cfg.mode == PowerMode::DROWSY) {
+        // lines woken during the interval count as awake for all of it
+        double asleep = (double) cache.drowsyLines() / lines;
+        on = (1 - asleep) + asleep * DROWSY_LEAKAGE;
+        if (recorded < maxIntervals) {
+            timeline[recorded++] = (uint32_t) ((lines - cache.drowsyLines()) * blockSize);
+        }
+    } else {
+        on = (double) cache.activeWays() * cache.activeSets() / lines;
+        if (recorded < maxIntervals) {
+            timeline[recorded++] = cache.activeWays() * cache.activeSets() * blockSize;
+        }
+    }
+    leakage += on * accesses;
+    weight += accesses;
+    if (recorded >= maxIntervals) {
+        return; // the run is over, switching anything off now only costs write-backs
+    }
+
+    if (cfg.mode == PowerMode::DROWSY) {
+        double wakeRate = (double) wakes / accesses;
+        if (wakeRate > cfg.slack && period < MAX_DROWSY_PERIOD) {
+            period *= 2;
+        } else if (wakeRate < cfg.slack / 2 && period > 1) {
+            period /= 2;
+        }
+        if (++sinceDoze >= period) {
+            cache.doze();
+            sinceDoze = 0;
+        }
+        return;
+    }
+
+    // the reference goes stale as the program changes phase, so every so
+    // often the cache goes back to full size to measure it again. a smaller
+    // cache doing better than the reference means the reference was taken
+    // in a worse phase (or while cold), so it is lowered on the spot
+    double rate = (double) misses / accesses;
+    bool full = cache.activeWays() == ways && cache.activeSets() == sets;
+    if (full || rate < reference) {
+        reference = rate;
+    }
+    if (full) {
+        sinceFull = 0;
+    } else if (++sinceFull >= RECHECK_INTERVALS) {
+        cache.setActiveWays(ways);
+        cache.setActiveSets(sets);
+        return;
+    }
+    bool grow = rate > reference * (1 + cfg.slack) + MISS_RATE_FLOOR;
+    bool shrink = rate <= reference * (1 + cfg.slack / 2) + MISS_RATE_FLOOR;
+    if (cfg.mode == PowerMode::WAYS) {
+        if (grow && cache.activeWays() < ways) {
+            cache.setActiveWays(cache.activeWays() + 1);
+        } else if (!grow && shrink && cache.activeWays() > 1) {
+            cache.setActiveWays(cache.activeWays() - 1);
+        }
+    } else {
+        if (grow && cache.activeSets() < sets) {
+            cache.setActiveSets(cache.activeSets() * 2);
+        } else if (!grow && shrink && cache.activeSets() > 1) {
+            cache.setActiveSets(cache.activeSets() / 2);
+        }
+    }
+}
+
+void PowerManager::report(const Cache &cache, const CacheStats &reference, ostream &out) const {
+    out << "Power capacity timeline:";
+    unsigned long r = 0;
+    double bytes = 0;
+    while (r < recorded) {
+        unsigned long run = 1;
+        while (r + run < recorded && timeline[r + run] == timeline[r]) {
+            run++;
+        }
+        out << " " << timeline[r] << "x" << run;
+        bytes += (double) timeline[r] * run;
+        r += run;
+    }
+    out << "\n";
+    const CacheStats &st = cache.stats();
+    long extra = (long) (st.loadMisses + st.storeMisses) -
+                 (long) (reference.loadMisses + reference.storeMisses);
+    double relative = weight > 0 ? leakage / weight : 1;
+    out << "Power average capacity: " << (recorded ? bytes / recorded : 0.0) << "\n";
+    out << "Power reference misses: " << reference.loadMisses + reference.storeMisses << "\n";
+    out << "Power extra misses: " << extra << "\n";
+    out << "Power extra cycles: " << (long) st.cycles - (long) reference.cycles << "\n";
+    out << "Power gated write-backs: " << cache.gatedWriteBacks() << "\n";
+    out << "Power drowsy wakes: " << cache.drowsyWakes() << "\n";
+    out << "Power relative leakage: " << relative << "\n";
+    out << "Power leakage savings: " << 1 - relative << "\n";
+}
@@ -0,0 +1,76 @@
+#ifndef POWER_H
+#define POWER_H
+
+#include <cstdint>
+#include <ostream>
+#include "arena.h"
+#include "cache.h"
+
+// what the power manager switches
+enum class PowerMode : uint8_t {
+    WAYS, // selective ways: whole ways are gated off in every set
+    SETS, // selective sets: the index shrinks to half (or a quarter...) of the sets
+    DROWSY // every line is put to sleep periodically and woken by the next hit
+};
+
+struct PowerConfig {
+    PowerMode mode = PowerMode::WAYS;
+    double slack = 0.10; // allowed miss rate increase (drowsy: wake-ups per access)
+};
+
+// interval-driven cache resizing for leakage (selective ways, Albonesi MICRO
+// 1999; selective sets / DRI, Yang et al. HPCA 2001; drowsy caches, Flautner
+// et al. ISCA 2002). every interval the miss rate is compared with the one
+// last seen at full size: within the slack (half of it, to avoid flapping)
+// the cache shrinks a step, beyond it the cache grows a step, and every
+// RECHECK_INTERVALS it goes back to full size for a fresh reference. in drowsy mode
+// all lines go to sleep every period intervals and the period doubles while
+// too many accesses pay the wake-up, and halves while few do. gated lines
+// leak nothing and drowsy lines DROWSY_LEAKAGE of an awake line
+class PowerManager : public IntervalObserver {
+public:
+    static constexpr double DROWSY_LEAKAGE = 0.125;
+
+    // maxIntervals is the number of intervals in the run (the last one may
+    // be partial), it sizes the capacity timeline
+    PowerManager(const PowerConfig &config, const CacheConfig &cache, unsigned long maxIntervals,
+                 Arena &arena);
+
+    void intervalEnd(Cache &cache, unsigned long interval) override;
+
+    // capacity timeline (run-length encoded), leakage, and the extra misses
+    // against a run of the same cache without power management
+    void report(const Cache &cache, const CacheStats &reference, std::ostream &out) const;
+
+private:
+    static const unsigned MAX_DROWSY_PERIOD = 64;
+
+    // miss rate the controller tolerates on top of any slack, so a cache
+    // that barely misses at full size still gets to shrink
+    static constexpr double MISS_RATE_FLOOR = 0.001;
+    static const unsigned RECHECK_INTERVALS = 32; // resized intervals between references
+
+    PowerConfig cfg;
+    unsigned ways;
+    unsigned sets;
+    size_t lines;
+    unsigned blockSize;
+
+    unsigned long lastAccesses = 0;
+    unsigned long lastMisses = 0;
+    unsigned long lastWakes = 0;
+    double reference = 1; // interval miss rate last seen at full size
+    unsigned sinceFull = 0;
+    unsigned period = 1; // drowsy: intervals between dozes
+    unsigned sinceDoze = 0;
+
+    // leakage relative to an always-on cache, weighted by interval accesses
+    double leakage = 0;
+    double weight = 0;
+
+    uint32_t *timeline; // enabled (drowsy: awake) bytes per interval
+    unsigned long maxIntervals;
+    unsigned long recorded = 0;
+};
+
+#endif
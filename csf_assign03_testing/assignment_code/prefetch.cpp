@@ -0,0 +1,94 @@
+#include <algorithm>
+#include "prefetch.h"
+
+using namespace std;
+
+bool parsePrefetchOptions(Options &opts, PrefetchConfig &config, vector<string> &names,
+                          string &error) {
+    string list = opts.get("prefetch", "");
+    size_t start = 0;
+    while (start < list.size()) {
+        size_t comma = list.find(',', start);
+        if (comma == string::npos) {
+            comma = list.size();
+        }
+        string name = list.substr(start, comma - start);
+        if (name != "markov" && name != "ghb" && name != "sms") {
+            error = "unknown prefetcher '" + name + "'";
+            return false;
+        }
+        names.push_back(name);
+        start = comma + 1;
+    }
+
+    // a table's options are only read when a prefetcher that uses them is
+    // selected, otherwise main reports them as unknown
+    auto selected = [&names](const char *name) {
+        return find(names.begin(), names.end(), name) != names.end();
+    };
+    bool markov = selected("markov"), ghb = selected("ghb"), sms = selected("sms");
+    unsigned long degree = config.degree, distance = config.distance;
+    unsigned long rows = config.markovRows, successors = config.markovSuccessors;
+    unsigned long ghbSize = config.ghbSize, ghbIndex = config.ghbIndexSize;
+    unsigned long region = min(config.smsRegionSize, 64 * config.blockSize), agt = config.smsAgtEntries;
+    unsigned long phtSets = config.smsPhtSets, phtWays = config.smsPhtWays;
+    unsigned long keyBits = config.smsKeyBits, smsDegree = config.smsDegree;
+    if ((!names.empty() && !opts.getUnsigned("prefetch-distance", distance, distance, error)) ||
+        ((markov || ghb) && !opts.getUnsigned("prefetch-degree", degree, degree, error)) ||
+        (markov && (!opts.getUnsigned("markov-rows", rows, rows, error) ||
+                    !opts.getUnsigned("markov-successors", successors, successors, error))) ||
+        (ghb && (!opts.getUnsigned("ghb-size", ghbSize, ghbSize, error) ||
+                 !opts.getUnsigned("ghb-index", ghbIndex, ghbIndex, error))) ||
+        (sms && (!opts.getUnsigned("sms-region", region, region, error) ||
+                 !opts.getUnsigned("sms-agt", agt, agt, error) ||
+                 !opts.getUnsigned("sms-pht-sets", phtSets, phtSets, error) ||
+                 !opts.getUnsigned("sms-pht-ways", phtWays, phtWays, error) ||
+                 !opts.getUnsigned("sms-key-bits", keyBits, keyBits, error) ||
+                 !opts.getUnsigned("sms-degree", smsDegree, smsDegree, error)))) {
+        return false;
+    }
+    if (degree < 1 || degree > PrefetchQueue::CAPACITY || distance < 1) {
+        error = "prefetch degree must be 1-64 and distance at least 1";
+        return false;
+    }
+    if (rows < 1 || successors < 1 || successors > 16 || ghbSize < 1 || ghbIndex < 1) {
+        error = "markov/ghb tables need at least one entry (and at most 16 successors)";
+        return false;
+    }
+    // a region's footprint has to fit the 64-bit bitmap
+    if (region < config.blockSize || region / config.blockSize > 64 || (region & (region - 1)) != 0) {
+        error = "--sms-region must be a power of two between one and 64 blocks";
+        return false;
+    }
+    if (agt < 1 || phtSets < 1 || phtWays < 1 || keyBits > 16 || smsDegree < 1 ||
+        smsDegree > PrefetchQueue::CAPACITY) {
+        error = "sms tables need at least one entry, at most 16 key bits and a degree of 1-64";
+        return false;
+    }
+    config.degree = degree;
+    config.distance = distance;
+    config.markovRows = rows;
+    config.markovSuccessors = successors;
+    config.ghbSize = ghbSize;
+    config.ghbIndexSize = ghbIndex;
+    config.smsRegionSize = region;
+    config.smsAgtEntries = agt;
+    config.smsPhtSets = phtSets;
+    config.smsPhtWays = phtWays;
+    config.smsKeyBits = keyBits;
+    config.smsDegree = smsDegree;
+    return true;
+}
+
+Prefetcher *makePrefetcher(const string &name, const PrefetchConfig &config, Arena &arena) {
+    if (name == "markov") {
+        return makeMarkovPrefetcher(config, arena);
+    }
+    if (name == "ghb") {
+        return makeGhbPrefetcher(config, arena);
+    }
+    if (name == "sms") {
+        return makeSmsPrefetcher(config, arena);
+    }
+    return nullptr;
+}
@@ -0,0 +1,101 @@
+#ifndef PREFETCH_H
+#define PREFETCH_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "arena.h"
+#include "options.h"
+
+// what the cache tells a prefetcher about each demand access
+enum class PrefetchEvent : uint8_t {
+    HIT, // demand hit on a line the demand stream brought in
+    MISS, // demand miss
+    PREFETCH_HIT // first demand hit on a prefetched line, trains like a miss
+};
+
+// candidates a prefetcher wants fetched, drained by the cache after every
+// access. fixed size, pushes beyond capacity are dropped
+class PrefetchQueue {
+public:
+    static const unsigned CAPACITY = 64;
+
+    void push(uint32_t block) {
+        if (count < CAPACITY) {
+            blocks[count++] = block;
+        }
+    }
+    unsigned size() const { return count; }
+    uint32_t operator[](unsigned i) const { return blocks[i]; }
+    void clear() { count = 0; }
+
+private:
+    uint32_t blocks[CAPACITY];
+    unsigned count = 0;
+};
+
+// table sizes and aggressiveness for every prefetcher, set from the
+// --prefetch-* / --markov-* / --ghb-* options
+struct PrefetchConfig {
+    unsigned degree = 2; // prefetches issued per trigger
+    unsigned distance = 1; // how far down the predicted stream to start
+    unsigned markovRows = 4096;
+    unsigned markovSuccessors = 4;
+    unsigned ghbSize = 4096; // history buffer entries
+    unsigned ghbIndexSize = 1024; // index table entries
+    unsigned blockSize = 4; // cache block size in bytes
+    unsigned smsRegionSize = 2048; // bytes per spatial region, capped at 64 blocks
+    unsigned smsAgtEntries = 64; // active generations tracked at once
+    unsigned smsPhtSets = 256;
+    unsigned smsPhtWays = 4;
+    unsigned smsKeyBits = 0; // low region-number bits mixed into the key
+    unsigned smsDegree = 32; // most blocks streamed per trigger
+};
+
+// a prefetcher sees block addresses (byte address >> offset bits) of demand
+// accesses and evictions. instances are placed in the engine arena along with
+// their tables and are never destroyed, so they must not own anything else
+class Prefetcher {
+public:
+    virtual const char *name() const = 0;
+
+    // called after every demand access has been handled
+    virtual void observe(uint32_t block, PrefetchEvent event, PrefetchQueue &out) = 0;
+
+    // a valid block left the cache (demand or prefetch victim)
+    virtual void evicted(uint32_t block) {
+        (void) block;
+    }
+
+    // aggressiveness knobs, may be changed while the run is going
+    unsigned degree = 2;
+    unsigned distance = 1;
+};
+
+// per-prefetcher counters kept by the cache
+struct PrefetchStats {
+    unsigned long issued = 0; // blocks actually brought in
+    unsigned long useful = 0; // prefetched lines later hit by demand
+    unsigned long late = 0; // useful, but the demand came before the data
+    unsigned long lateCycles = 0; // cycles spent waiting on those
+    unsigned long unused = 0; // prefetched lines evicted without a demand hit
+    unsigned long dropped = 0; // not issued because the memory bus was backed up
+};
+
+// read --prefetch=<name>[,<name>...] and the table size / aggressiveness
+// options of the prefetchers it names (the rest are left unread, so main
+// rejects them). returns false and sets error on a bad value or unknown
+// prefetcher
+bool parsePrefetchOptions(Options &opts, PrefetchConfig &config, std::vector<std::string> &names,
+                          std::string &error);
+
+// build the named prefetcher ("markov", "ghb" or "sms") in the arena, nullptr if
+// there is no prefetcher with that name
+Prefetcher *makePrefetcher(const std::string &name, const PrefetchConfig &config, Arena &arena);
+
+// the individual prefetchers (correlation.cpp, spatial.cpp)
+Prefetcher *makeMarkovPrefetcher(const PrefetchConfig &config, Arena &arena);
+Prefetcher *makeGhbPrefetcher(const PrefetchConfig &config, Arena &arena);
+Prefetcher *makeSmsPrefetcher(const PrefetchConfig &config, Arena &arena);
+
+#endif
@@ -0,0 +1,276 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#include "results.h"
+
+using namespace std;
+
+const char RESULTS_MAGIC[8] = {'C', 'S', 'I', 'M', 'R', 'E', 'S', '1'};
+
+namespace {
+
+struct FileHeader {
+    char magic[8];
+    uint64_t rows;
+    uint32_t columns;
+    uint32_t unused;
+};
+
+struct IndexEntry {
+    char name[16];
+    uint32_t encoding;
+    uint32_t dictCount;
+    uint64_t offset; // of the column data
+    uint64_t bytes;
+    uint64_t dictOffset; // strings as a two-byte length and the bytes
+};
+
+size_t align8(size_t n) {
+    return (n + 7) & ~(size_t) 7;
+}
+
+unsigned log2Of(unsigned long n) {
+    unsigned bits = 0;
+    while ((1ul << bits) < n) {
+        bits++;
+    }
+    return bits;
+}
+
+size_t rowBytes(ColumnEncoding encoding) {
+    switch (encoding) {
+    case ColumnEncoding::LOG2:
+    case ColumnEncoding::FLAG:
+        return 1;
+    case ColumnEncoding::DICT:
+        return 2;
+    case ColumnEncoding::U32:
+        return 4;
+    default:
+        return 8;
+    }
+}
+
+}
+
+ResultsWriter::ResultsWriter() {
+    const char *names[] = {"trace", "sets", "ways", "block", "alloc", "write", "policy"};
+    ColumnEncoding encodings[] = {ColumnEncoding::DICT, ColumnEncoding::LOG2, ColumnEncoding::LOG2,
+                                  ColumnEncoding::LOG2, ColumnEncoding::FLAG, ColumnEncoding::FLAG,
+                                  ColumnEncoding::DICT};
+    for (size_t i = 0; i < 7; i++) {
+        columns.push_back(Pending{names[i], encodings[i], {}, {}, {}});
+    }
+    // counters are narrowed to 32 bits when writing if they all fit
+    for (const char *name : {"loads", "stores", "load_hits", "load_misses", "store_hits",
+                             "store_misses", "cycles"}) {
+        columns.push_back(Pending{name, ColumnEncoding::U64, {}, {}, {}});
+    }
+}
+
+void ResultsWriter::addString(Pending &column, const string &value) {
+    auto it = column.codes.find(value);
+    if (it == column.codes.end()) {
+        it = column.codes.emplace(value, (uint32_t) column.dict.size()).first;
+        column.dict.push_back(value);
+    }
+    column.values.push_back(it->second);
+}
+
+void ResultsWriter::add(const string &trace, const CacheConfig &config, const CacheStats &stats) {
+    addString(columns[0], trace);
+    columns[1].values.push_back(log2Of(config.numSets));
+    columns[2].values.push_back(log2Of(config.blocksPerSet));
+    columns[3].values.push_back(log2Of(config.blockSize));
+    columns[4].values.push_back(config.writeAllocate);
+    columns[5].values.push_back(config.writeBack);
+    addString(columns[6], config.policy->name);
+    const unsigned long counters[] = {stats.totalLoads, stats.totalStores, stats.loadHits,
+                                      stats.loadMisses, stats.storeHits,   stats.storeMisses,
+                                      stats.cycles};
+    for (size_t i = 0; i < 7; i++) {
+        columns[7 + i].values.push_back(counters[i]);
+    }
+    count++;
+}
+
+bool ResultsWriter::write(const string &path, string &error) const {
+    // lay the file out first: header, index, then per column its dictionary
+    // and its data
+    // codes and string lengths are two bytes each in the file
+    for (const Pending &col : columns) {
+        if (col.dict.size() > (size_t) UINT16_MAX + 1) {
+            error = "more than 65536 distinct " + col.name + " names for " + path;
+            return false;
+        }
+        for (const string &s : col.dict) {
+            if (s.size() > UINT16_MAX) {
+                error = col.name + " name longer than 65535 bytes for " + path;
+                return false;
+            }
+        }
+    }
+
+    vector<IndexEntry> index(columns.size());
+    size_t offset = sizeof(FileHeader) + sizeof(IndexEntry) * columns.size();
+    for (size_t c = 0; c < columns.size(); c++) {
+        const Pending &col = columns[c];
+        IndexEntry &e = index[c];
+        memset(&e, 0, sizeof(e));
+        strncpy(e.name, col.name.c_str(), sizeof(e.name) - 1);
+        ColumnEncoding encoding = col.encoding;
+        if (encoding == ColumnEncoding::U64) {
+            uint64_t largest = 0;
+            for (uint64_t v : col.values) {
+                largest = max(largest, v);
+            }
+            encoding = largest <= UINT32_MAX ? ColumnEncoding::U32 : ColumnEncoding::U64;
+        }
+        e.encoding = (uint32_t) encoding;
+        e.dictCount = col.dict.size();
+        if (!col.dict.empty()) {
+            e.dictOffset = offset;
+            for (const string &s : col.dict) {
+                offset += 2 + s.size();
+            }
+            offset = align8(offset);
+        }
+        e.offset = offset;
+        e.bytes = rowBytes(encoding) * count;
+        offset = align8(offset + e.bytes);
+    }
+
+    vector<uint8_t> out(offset, 0);
+    FileHeader header;
+    memcpy(header.magic, RESULTS_MAGIC, sizeof(header.magic));
+    header.rows = count;
+    header.columns = columns.size();
+    header.unused = 0;
+    memcpy(out.data(), &header, sizeof(header));
+    memcpy(out.data() + sizeof(header), index.data(), sizeof(IndexEntry) * index.size());
+    for (size_t c = 0; c < columns.size(); c++) {
+        const Pending &col = columns[c];
+        const IndexEntry &e = index[c];
+        uint8_t *p = out.data() + e.dictOffset;
+        for (const string &s : col.dict) {
+            uint16_t len = s.size();
+            memcpy(p, &len, 2);
+            memcpy(p + 2, s.data(), s.size());
+            p += 2 + s.size();
+        }
+        uint8_t *data = out.data() + e.offset;
+        for (size_t r = 0; r < count; r++) {
+            uint64_t v = col.values[r];
+            switch ((ColumnEncoding) e.encoding) {
+            case ColumnEncoding::LOG2:
+            case ColumnEncoding::FLAG:
+                data[r] = (uint8_t) v;
+                break;
+            case ColumnEncoding::DICT:
+                reinterpret_cast<uint16_t *>(data)[r] = (uint16_t) v;
+                break;
+            case ColumnEncoding::U32:
+                reinterpret_cast<uint32_t *>(data)[r] = (uint32_t) v;
+                break;
+            default:
+                reinterpret_cast<uint64_t *>(data)[r] = v;
+            }
+        }
+    }
+
+    FILE *f = fopen(path.c_str(), "wb");
+    bool ok = f != nullptr && fwrite(out.data(), 1, out.size(), f) == out.size();
+    if (f != nullptr) {
+        ok &= fclose(f) == 0;
+    }
+    if (!ok) {
+        error = "could not write " + path;
+    }
+    return ok;
+}
+
+ResultsFile::~ResultsFile() {
+    if (map != nullptr) {
+        munmap(map, mapBytes);
+    }
+}
+
+bool ResultsFile::open(const string &path, string &error) {
+    error = path + " is not a results file";
+    int fd = ::open(path.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        error = "could not open " + path;
+        return false;
+    }
+    mapBytes = st.st_size;
+    if (mapBytes < sizeof(FileHeader)) {
+        close(fd);
+        return false;
+    }
+    map = mmap(nullptr, mapBytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        map = nullptr;
+        error = "could not map " + path;
+        return false;
+    }
+
+    const uint8_t *base = static_cast<const uint8_t *>(map);
+    FileHeader header;
+    memcpy(&header, base, sizeof(header));
+    // every row takes at least a byte in each column, which also keeps the
+    // column sizes below from overflowing
+    if (memcmp(header.magic, RESULTS_MAGIC, sizeof(header.magic)) != 0 || header.rows > mapBytes ||
+        header.columns > mapBytes ||
+        mapBytes < sizeof(FileHeader) + sizeof(IndexEntry) * (size_t) header.columns) {
+        return false;
+    }
+    count = header.rows;
+    for (uint32_t c = 0; c < header.columns; c++) {
+        IndexEntry e;
+        memcpy(&e, base + sizeof(FileHeader) + sizeof(IndexEntry) * c, sizeof(e));
+        ColumnEncoding encoding = (ColumnEncoding) e.encoding;
+        if (e.encoding < (uint32_t) ColumnEncoding::LOG2 ||
+            e.encoding > (uint32_t) ColumnEncoding::U64 || e.offset % 8 != 0 ||
+            e.bytes != rowBytes(encoding) * count || e.offset > mapBytes ||
+            e.bytes > mapBytes - e.offset) {
+            return false;
+        }
+        ResultColumn col;
+        col.name.assign(e.name, strnlen(e.name, sizeof(e.name)));
+        col.encoding = encoding;
+        col.data = base + e.offset;
+        size_t p = e.dictOffset;
+        for (uint32_t i = 0; i < e.dictCount; i++) {
+            uint16_t len;
+            if (p + 2 > mapBytes) {
+                return false;
+            }
+            memcpy(&len, base + p, 2);
+            if (p + 2 + len > mapBytes) {
+                return false;
+            }
+            col.dict.emplace_back(reinterpret_cast<const char *>(base + p + 2), len);
+            p += 2 + len;
+        }
+        cols.push_back(col);
+    }
+    error.clear();
+    return true;
+}
+
+const ResultColumn *ResultsFile::column(const string &name) const {
+    for (const ResultColumn &col : cols) {
+        if (col.name == name) {
+            return &col;
+        }
+    }
+    return nullptr;
+}
@@ -0,0 +1,101 @@
+#ifndef RESULTS_H
+#define RESULTS_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+#include "cache.h"
+
+// how a column of a results file is stored
+enum class ColumnEncoding : uint32_t {
+    LOG2 = 1, // a power of two as its log2, one byte per row
+    FLAG, // 0 or 1, one byte per row
+    DICT, // two-byte codes into the column's string dictionary
+    U32, // counters that all fit in 32 bits
+    U64
+};
+
+// magic at the start of a results file
+extern const char RESULTS_MAGIC[8];
+
+// collects sweep results a column at a time and writes them as a columnar
+// file: the magic, the row and column counts, an index entry per column
+// (name, encoding, where its data and dictionary are), then the columns,
+// each 8-byte aligned. the columns are trace, sets, ways, block, alloc,
+// write, policy and the seven summary counters
+class ResultsWriter {
+public:
+    ResultsWriter();
+
+    void add(const std::string &trace, const CacheConfig &config, const CacheStats &stats);
+    size_t rows() const { return count; }
+
+    // false (with error set) if the file cannot be written
+    bool write(const std::string &path, std::string &error) const;
+
+private:
+    struct Pending {
+        std::string name;
+        ColumnEncoding encoding;
+        std::vector<uint64_t> values; // log2, flag, code or the counter
+        std::vector<std::string> dict;
+        std::map<std::string, uint32_t> codes; // may outgrow the two-byte codes, write checks
+    };
+
+    void addString(Pending &column, const std::string &value);
+
+    std::vector<Pending> columns;
+    size_t count = 0;
+};
+
+// one column of a mapped results file
+struct ResultColumn {
+    std::string name;
+    ColumnEncoding encoding;
+    const uint8_t *data; // points into the mapping
+    std::vector<std::string> dict; // DICT columns only
+
+    // the row's number (for DICT columns its code)
+    uint64_t at(size_t row) const {
+        switch (encoding) {
+        case ColumnEncoding::LOG2:
+            return 1ull << data[row];
+        case ColumnEncoding::FLAG:
+            return data[row];
+        case ColumnEncoding::DICT:
+            return reinterpret_cast<const uint16_t *>(data)[row];
+        case ColumnEncoding::U32:
+            return reinterpret_cast<const uint32_t *>(data)[row];
+        default:
+            return reinterpret_cast<const uint64_t *>(data)[row];
+        }
+    }
+};
+
+// a results file mapped read-only, the columns are used in place
+class ResultsFile {
+public:
+    ResultsFile() = default;
+    ~ResultsFile();
+
+    ResultsFile(const ResultsFile &) = delete;
+    ResultsFile &operator=(const ResultsFile &) = delete;
+
+    // false (with error set) if the file is missing, truncated or not a
+    // results file
+    bool open(const std::string &path, std::string &error);
+
+    size_t rows() const { return count; }
+    const std::vector<ResultColumn> &columns() const { return cols; }
+    // nullptr if there is no such column
+    const ResultColumn *column(const std::string &name) const;
+
+private:
+    void *map = nullptr;
+    size_t mapBytes = 0;
+    size_t count = 0;
+    std::vector<ResultColumn> cols;
+};
+
+#endif
@@ -0,0 +1,196 @@
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include "reuse.h"
+#include "thread_pool.h"
+
+using namespace std;
+
+namespace {
+
+const unsigned BUCKETS = 64;
+
+// counts over positions 0..n-1 with prefix sums in O(log n)
+class Fenwick {
+public:
+    explicit Fenwick(size_t n) : tree(n + 1, 0) {}
+
+    void add(size_t i, long delta) {
+        for (i++; i < tree.size(); i += i & (~i + 1)) {
+            tree[i] += delta;
+        }
+    }
+
+    // sum over [0, i)
+    long prefix(size_t i) const {
+        long sum = 0;
+        for (; i > 0; i -= i & (~i + 1)) {
+            sum += tree[i];
+        }
+        return sum;
+    }
+
+private:
+    vector<long> tree;
+};
+
+unsigned bucketOf(unsigned long distance) {
+    return distance == 0 ? 0 : 64 - __builtin_clzl(distance);
+}
+
+// what one chunk finds out on its own
+struct Chunk {
+    size_t begin = 0;
+    size_t end = 0;
+    vector<unsigned long> buckets;
+    unsigned long long distanceSum = 0;
+    vector<uint32_t> firstBlocks; // in the order the chunk first touches them
+    vector<uint32_t> lastBlocks; // in the order of their last touch in the chunk
+};
+
+// the plain sequential pass over one chunk: a 1 in live marks the latest
+// touch of every block so far, so the distance of a reuse is the number of
+// 1s between the two touches
+void profileChunk(span<const TraceRecord> records, unsigned blockBits, Chunk &chunk) {
+    size_t n = chunk.end - chunk.begin;
+    Fenwick live(n);
+    unordered_map<uint32_t, size_t> last;
+    chunk.buckets.assign(BUCKETS, 0);
+    for (size_t i = 0; i < n; i++) {
+        uint32_t block = records[chunk.begin + i].addr >> blockBits;
+        auto found = last.try_emplace(block, i);
+        if (found.second) {
+            chunk.firstBlocks.push_back(block);
+        } else {
+            size_t prev = found.first->second;
+            unsigned long distance = live.prefix(i) - live.prefix(prev + 1);
+            chunk.buckets[bucketOf(distance)]++;
+            chunk.distanceSum += distance;
+            live.add(prev, -1);
+            found.first->second = i;
+        }
+        live.add(i, 1);
+    }
+
+    vector<pair<size_t, uint32_t>> lasts;
+    lasts.reserve(last.size());
+    for (const auto &entry : last) {
+        lasts.emplace_back(entry.second, entry.first);
+    }
+    sort(lasts.begin(), lasts.end());
+    chunk.lastBlocks.reserve(lasts.size());
+    for (const auto &entry : lasts) {
+        chunk.lastBlocks.push_back(entry.second);
+    }
+}
+
+}
+
+ReuseHistogram reuseDistances(span<const TraceRecord> records, const ReuseConfig &config) {
+    auto start = chrono::steady_clock::now();
+    unsigned blockBits = 0;
+    while ((1u << blockBits) < config.blockSize) {
+        blockBits++;
+    }
+
+    unique_ptr<ThreadPool> pool;
+    if (config.threads != 1) {
+        pool.reset(new ThreadPool(config.threads, config.pin));
+    }
+    ReuseHistogram h;
+    h.threads = pool ? pool->size() : 1;
+    size_t count = config.chunks != 0 ? config.chunks : h.threads;
+    count = max<size_t>(1, min(count, records.size()));
+    h.chunks = count;
+
+    vector<Chunk> chunks(count);
+    for (size_t c = 0; c < count; c++) {
+        chunks[c].begin = records.size() * c / count;
+        chunks[c].end = records.size() * (c + 1) / count;
+        if (!pool) {
+            profileChunk(records, blockBits, chunks[c]);
+        } else {
+            Chunk *chunk = &chunks[c];
+            pool->submit([&records, blockBits, chunk] { profileChunk(records, blockBits, *chunk); });
+        }
+    }
+    if (pool) {
+        pool->wait();
+        h.pool = pool->stats();
+    }
+
+    // a chunk's first touch of a block last seen in an earlier chunk: the
+    // blocks in between are the ones the chunk already touched (one per
+    // earlier first touch) plus the ones whose latest touch before the chunk
+    // comes after the block's. the latter sit in live, indexed by the
+    // chunks' last touches in trace order, and leave it once the chunk has
+    // touched them so they are not counted twice
+    auto mergeStart = chrono::steady_clock::now();
+    h.buckets.assign(BUCKETS, 0);
+    size_t lastTouches = 0;
+    for (const Chunk &chunk : chunks) {
+        lastTouches += chunk.lastBlocks.size();
+    }
+    Fenwick live(lastTouches);
+    long liveCount = 0;
+    unordered_map<uint32_t, size_t> lastIndex;
+    lastIndex.reserve(lastTouches);
+    size_t offset = 0;
+    for (const Chunk &chunk : chunks) {
+        for (unsigned b = 0; b < BUCKETS; b++) {
+            h.buckets[b] += chunk.buckets[b];
+        }
+        h.distanceSum += chunk.distanceSum;
+        for (size_t i = 0; i < chunk.firstBlocks.size(); i++) {
+            auto found = lastIndex.find(chunk.firstBlocks[i]);
+            if (found == lastIndex.end()) {
+                h.cold++;
+                continue;
+            }
+            size_t k = found->second;
+            unsigned long distance = i + (liveCount - live.prefix(k + 1));
+            h.buckets[bucketOf(distance)]++;
+            h.distanceSum += distance;
+            h.merged++;
+            live.add(k, -1);
+            liveCount--;
+        }
+        for (size_t j = 0; j < chunk.lastBlocks.size(); j++) {
+            live.add(offset + j, 1);
+            liveCount++;
+            lastIndex[chunk.lastBlocks[j]] = offset + j;
+        }
+        offset += chunk.lastBlocks.size();
+    }
+
+    auto done = chrono::steady_clock::now();
+    h.mergeSeconds = chrono::duration<double>(done - mergeStart).count();
+    h.seconds = chrono::duration<double>(done - start).count();
+    return h;
+}
+
+void printReuse(const ReuseHistogram &h, ostream &out) {
+    size_t used = h.buckets.size();
+    while (used > 0 && h.buckets[used - 1] == 0) {
+        used--;
+    }
+    unsigned long reuses = 0;
+    out << "Reuse distance cold: " << h.cold << "\n";
+    for (size_t b = 0; b < used; b++) {
+        reuses += h.buckets[b];
+        if (b < 2) {
+            out << "Reuse distance " << b << ": " << h.buckets[b] << "\n";
+        } else {
+            out << "Reuse distance " << (1ul << (b - 1)) << "-" << (1ul << b) - 1 << ": "
+                << h.buckets[b] << "\n";
+        }
+    }
+    out << "Reuse distance mean: " << (reuses ? (double) h.distanceSum / reuses : 0.0) << "\n";
+    out << "Reuse distance chunks: " << h.chunks << "\n";
+    out << "Reuse distance threads: " << h.threads << "\n";
+    out << "Reuse distance merged reuses: " << h.merged << "\n";
+    out << "Reuse distance seconds: " << h.seconds << "\n";
+    out << "Reuse distance merge seconds: " << h.mergeSeconds << "\n";
+}
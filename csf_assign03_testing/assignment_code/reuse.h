@@ -0,0 +1,45 @@
+#ifndef REUSE_H
+#define REUSE_H
+
+#include <cstdint>
+#include <ostream>
+#include <span>
+#include <vector>
+#include "thread_pool.h"
+#include "trace.h"
+
+// how to profile the reuse distances of a trace
+struct ReuseConfig {
+    unsigned blockSize = 4; // distances count distinct blocks of this size
+    unsigned threads = 1; // 0 for one per core
+    unsigned chunks = 0; // 0 for one per thread
+    Pinning pin = Pinning::NONE;
+};
+
+// reuse distance of an access: the number of distinct blocks touched since
+// the last access to its block. bucket 0 holds distance 0 and bucket k the
+// distances from 2^(k-1) to 2^k - 1, so the share of accesses in buckets
+// below k is the hit rate of a fully associative lru cache of 2^(k-1) blocks
+struct ReuseHistogram {
+    std::vector<unsigned long> buckets;
+    unsigned long cold = 0; // first touches, one per distinct block
+    unsigned long long distanceSum = 0; // over the reuses, for the mean
+    unsigned chunks = 0;
+    unsigned threads = 0;
+    unsigned long merged = 0; // reuses that crossed a chunk boundary
+    double seconds = 0;
+    double mergeSeconds = 0;
+    ThreadPool::Stats pool; // idle and contention of the threads, if any
+};
+
+// exact reuse distances of every record. the trace is cut into chunks that
+// are profiled on their own across a thread pool (distances of reuses inside
+// the chunk, plus the blocks each chunk touches first and last), then the
+// reuses that cross chunks are resolved in chunk order against a Fenwick
+// tree over the chunks' last touches. one chunk is the plain sequential pass
+// and any number of chunks gives the same histogram
+ReuseHistogram reuseDistances(std::span<const TraceRecord> records, const ReuseConfig &config);
+
+void printReuse(const ReuseHistogram &histogram, std::ostream &out);
+
+#endif
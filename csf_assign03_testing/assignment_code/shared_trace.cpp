@@ -0,0 +1,187 @@
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstring>
+#include <vector>
+#include "shared_trace.h"
+
+using namespace std;
+
+namespace {
+
+const char SEGMENT_MAGIC[8] = {'C', 'S', 'I', 'M', 'S', 'H', 'M', '1'};
+// the records start a cache line into the segment
+const size_t HEADER_BYTES = 64;
+
+struct SegmentHeader {
+    char magic[8];
+    uint64_t hash;
+    uint64_t bytes; // size of the trace the records were decoded from
+    uint64_t count;
+    uint32_t recordSize;
+    uint32_t ready; // set last, once the records are all in place
+};
+
+// 64-bit hash of the trace's bytes, eight at a time. the record layout is
+// mixed in so a build with a different TraceRecord never maps our segments
+uint64_t hashBytes(const char *p, size_t size) {
+    uint64_t h = 0x9e3779b97f4a7c15ull ^ size ^ ((uint64_t) sizeof(TraceRecord) << 56);
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, p + i, 8);
+        h = (h ^ word) * 0xff51afd7ed558ccdull;
+        h ^= h >> 29;
+    }
+    uint64_t tail = 0;
+    if (i < size) {
+        memcpy(&tail, p + i, size - i);
+    }
+    h = (h ^ tail) * 0xff51afd7ed558ccdull;
+    h ^= h >> 32;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    return h ^ (h >> 29);
+}
+
+}
+
+SharedTrace::~SharedTrace() {
+    if (map != nullptr) {
+        munmap(map, mapBytes);
+    }
+}
+
+bool SharedTrace::open(FILE *in, string &error) {
+    // a trace file on stdin is hashed straight out of its mapping, anything
+    // else (a pipe) is read in first
+    int fd = fileno(in);
+    struct stat st;
+    void *input = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 && lseek(fd, 0, SEEK_CUR) == 0) {
+        input = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    }
+    vector<char> text;
+    const char *bytes;
+    size_t size;
+    if (input != MAP_FAILED) {
+        bytes = static_cast<const char *>(input);
+        size = st.st_size;
+    } else if (readTraceBytes(in, text)) {
+        bytes = text.data();
+        size = text.size();
+    } else {
+        error = "could not read trace from stdin";
+        return false;
+    }
+
+    uint64_t hash = hashBytes(bytes, size);
+    char name[32];
+    snprintf(name, sizeof(name), "/csim-trace-%016llx", (unsigned long long) hash);
+    segment = name;
+    bool ok = attach(hash, size) || publish(hash, bytes, size, error);
+    if (input != MAP_FAILED) {
+        munmap(input, size);
+    }
+    return ok;
+}
+
+// map the segment if it holds a finished copy of this trace
+bool SharedTrace::attach(uint64_t hash, size_t bytes) {
+    int fd = shm_open(segment.c_str(), O_RDONLY, 0);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || (size_t) st.st_size < HEADER_BYTES) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return false;
+    }
+    void *m = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (m == MAP_FAILED) {
+        return false;
+    }
+
+    // ready is stored with release order after everything else, so once it
+    // reads 1 the rest of the header and the records are there too
+    const SegmentHeader *header = static_cast<const SegmentHeader *>(m);
+    bool ok = __atomic_load_n(&header->ready, __ATOMIC_ACQUIRE) == 1 &&
+              memcmp(header->magic, SEGMENT_MAGIC, sizeof(SEGMENT_MAGIC)) == 0 &&
+              header->hash == hash && header->bytes == bytes &&
+              header->recordSize == sizeof(TraceRecord) &&
+              header->count <= ((size_t) st.st_size - HEADER_BYTES) / sizeof(TraceRecord);
+    if (!ok) {
+        munmap(m, st.st_size);
+        return false;
+    }
+    map = m;
+    mapBytes = st.st_size;
+    recs = reinterpret_cast<const TraceRecord *>(static_cast<const char *>(m) + HEADER_BYTES);
+    count = header->count;
+    return true;
+}
+
+// decode the trace into a new segment under the lock, unless another process
+// published it while we waited for the lock
+bool SharedTrace::publish(uint64_t hash, const char *bytes, size_t size, string &error) {
+    string lockPath = "/dev/shm" + segment + ".lock";
+    int lock = ::open(lockPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+    if (lock < 0 || flock(lock, LOCK_EX) != 0) {
+        if (lock >= 0) {
+            close(lock);
+        }
+        error = "could not lock " + lockPath;
+        return false;
+    }
+    if (attach(hash, size)) {
+        close(lock);
+        return true;
+    }
+
+    vector<TraceRecord> decoded;
+    if (!decodeTrace(bytes, size, decoded, error)) {
+        close(lock);
+        error = "stdin: " + error;
+        return false;
+    }
+    // a segment that is already there was left half-built by a process that
+    // died holding the lock
+    shm_unlink(segment.c_str());
+    int fd = shm_open(segment.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    size_t total = HEADER_BYTES + decoded.size() * sizeof(TraceRecord);
+    void *m = MAP_FAILED;
+    // posix_fallocate rather than ftruncate: a full /dev/shm fails here
+    // instead of with a SIGBUS halfway through the copy
+    if (fd >= 0 && posix_fallocate(fd, 0, total) == 0) {
+        m = mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    if (m == MAP_FAILED) {
+        shm_unlink(segment.c_str());
+        close(lock);
+        error = "could not make shared memory segment /dev/shm" + segment;
+        return false;
+    }
+
+    SegmentHeader header{};
+    memcpy(header.magic, SEGMENT_MAGIC, sizeof(SEGMENT_MAGIC));
+    header.hash = hash;
+    header.bytes = size;
+    header.count = decoded.size();
+    header.recordSize = sizeof(TraceRecord);
+    memcpy(m, &header, sizeof(header));
+    memcpy(static_cast<char *>(m) + HEADER_BYTES, decoded.data(), decoded.size() * sizeof(TraceRecord));
+    __atomic_store_n(&static_cast<SegmentHeader *>(m)->ready, 1u, __ATOMIC_RELEASE);
+    munmap(m, total);
+
+    builder = true;
+    bool ok = attach(hash, size);
+    close(lock);
+    if (!ok) {
+        error = "could not map shared memory segment /dev/shm" + segment;
+    }
+    return ok;
+}
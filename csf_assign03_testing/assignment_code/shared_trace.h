@@ -0,0 +1,47 @@
+#ifndef SHARED_TRACE_H
+#define SHARED_TRACE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <span>
+#include <string>
+#include "trace.h"
+
+// a decoded trace shared by every csim process running on it. the records
+// live in a POSIX shared memory segment named after a hash of the trace's
+// bytes (/dev/shm/csim-trace-<hash>). the first process to get there decodes
+// the trace and publishes it while holding an flock on a lock file beside the
+// segment; the others wait on that lock if they have to and then map the
+// segment read-only, so they neither parse the trace nor keep a copy of it.
+// segments outlive the processes, rm /dev/shm/csim-trace-* drops them
+class SharedTrace {
+public:
+    SharedTrace() = default;
+    ~SharedTrace();
+
+    SharedTrace(const SharedTrace &) = delete;
+    SharedTrace &operator=(const SharedTrace &) = delete;
+
+    // read the trace on in and map its records, publishing them first if no
+    // other process has. false (with error set) if the trace cannot be read
+    // or the segment cannot be made
+    bool open(std::FILE *in, std::string &error);
+
+    std::span<const TraceRecord> records() const { return {recs, count}; }
+    // whether this process was the one that decoded and published it
+    bool built() const { return builder; }
+    const std::string &name() const { return segment; }
+
+private:
+    bool attach(uint64_t hash, size_t bytes);
+    bool publish(uint64_t hash, const char *bytes, size_t size, std::string &error);
+
+    void *map = nullptr;
+    size_t mapBytes = 0;
+    const TraceRecord *recs = nullptr;
+    size_t count = 0;
+    bool builder = false;
+    std::string segment;
+};
+
+#endif
@@ -0,0 +1,169 @@
+#include <algorithm>
+#include "sharing.h"
+
+using namespace std;
+
+namespace {
+
+// ThreadEntry::flags
+const uint8_t SEEN = 1; // the thread has had a copy of the block
+const uint8_t VALID = 2; // and still has it
+
+uint64_t threadKey(uint32_t block, unsigned thread) {
+    return ((uint64_t) block << 4 | thread) + 1;
+}
+
+}
+
+template <typename Entry>
+SharingDetector::Table<Entry>::Table() : entries(1024) {}
+
+template <typename Entry>
+size_t SharingDetector::Table<Entry>::slot(uint64_t key) const {
+    return (size_t) ((key * 0x9e3779b97f4a7c15ull) >> 20) & (entries.size() - 1);
+}
+
+template <typename Entry>
+void SharingDetector::Table<Entry>::grow() {
+    vector<Entry> old(entries.size() * 2);
+    old.swap(entries);
+    for (const Entry &e : old) {
+        if (e.key != 0) {
+            size_t i = slot(e.key);
+            while (entries[i].key != 0) {
+                i = (i + 1) & (entries.size() - 1);
+            }
+            entries[i] = e;
+        }
+    }
+}
+
+template <typename Entry>
+Entry &SharingDetector::Table<Entry>::insert(uint64_t key) {
+    if ((used + 1) * 4 > entries.size() * 3) {
+        grow();
+    }
+    size_t i = slot(key);
+    while (entries[i].key != 0 && entries[i].key != key) {
+        i = (i + 1) & (entries.size() - 1);
+    }
+    if (entries[i].key == 0) {
+        entries[i] = Entry();
+        entries[i].key = key;
+        used++;
+    }
+    return entries[i];
+}
+
+template <typename Entry>
+Entry *SharingDetector::Table<Entry>::find(uint64_t key) {
+    size_t i = slot(key);
+    while (entries[i].key != 0) {
+        if (entries[i].key == key) {
+            return &entries[i];
+        }
+        i = (i + 1) & (entries.size() - 1);
+    }
+    return nullptr;
+}
+
+SharingDetector::SharingDetector(const SharingConfig &config) : cfg(config) {
+    blockBits = 0;
+    while ((1u << blockBits) < cfg.blockSize) {
+        blockBits++;
+    }
+}
+
+void SharingDetector::access(unsigned thread, const TraceRecord &rec) {
+    uint32_t block = rec.addr >> blockBits;
+    unsigned offset = rec.addr & (cfg.blockSize - 1);
+    unsigned bytes = min(cfg.accessSize, cfg.blockSize - offset);
+    uint64_t mask = (bytes == 64 ? ~0ull : ((1ull << bytes) - 1)) << offset;
+    uint32_t window = (uint32_t) (index++ / cfg.window);
+
+    BlockEntry &b = blocks.insert(block + 1);
+    SharedBlock &totals = b.totals;
+    totals.block = block;
+    totals.accesses++;
+    totals.threads |= 1u << thread;
+    ThreadEntry &me = perThread.insert(threadKey(block, thread));
+    if (me.window != window) {
+        me.read = 0;
+        me.write = 0;
+        me.window = window;
+    }
+
+    // our copy was invalidated by someone else's write since we last had it
+    if ((me.flags & SEEN) && !(me.flags & VALID)) {
+        if (mask & me.writtenSince) {
+            totals.trueMisses++;
+            totalTrue++;
+        } else {
+            totals.falseMisses++;
+            totalFalse++;
+        }
+    }
+    me.flags = SEEN | VALID;
+    me.writtenSince = 0;
+
+    if (!rec.isStore) {
+        me.read |= mask;
+        return;
+    }
+    me.write |= mask;
+    totals.writers |= 1u << thread;
+
+    // invalidate the other copies, and see whether their writes this window
+    // were on other bytes of the block
+    bool disjoint = false;
+    for (unsigned u = 0; u < MAX_THREADS; u++) {
+        if (u == thread || !(totals.threads & (1u << u))) {
+            continue;
+        }
+        ThreadEntry *other = perThread.find(threadKey(block, u));
+        if (other->window == window && other->write != 0 && !(other->write & mask)) {
+            disjoint = true;
+        }
+        if (other->flags & VALID) {
+            other->flags &= ~VALID;
+            other->writtenSince = mask;
+        } else {
+            other->writtenSince |= mask;
+        }
+    }
+    if (disjoint) {
+        totals.disjointWrites++;
+        totalDisjoint++;
+    }
+}
+
+unsigned long SharingDetector::sharedWrittenBlocks() const {
+    unsigned long n = 0;
+    for (const BlockEntry &b : blocks.slots()) {
+        // more than one writer bit set
+        n += b.key != 0 && (b.totals.writers & (b.totals.writers - 1)) != 0;
+    }
+    return n;
+}
+
+vector<SharedBlock> SharingDetector::top(size_t n) const {
+    vector<SharedBlock> all;
+    for (const BlockEntry &b : blocks.slots()) {
+        if (b.key != 0 && (b.totals.falseMisses != 0 || b.totals.disjointWrites != 0)) {
+            all.push_back(b.totals);
+        }
+    }
+    sort(all.begin(), all.end(), [](const SharedBlock &x, const SharedBlock &y) {
+        if (x.falseMisses != y.falseMisses) {
+            return x.falseMisses > y.falseMisses;
+        }
+        if (x.disjointWrites != y.disjointWrites) {
+            return x.disjointWrites > y.disjointWrites;
+        }
+        return x.block < y.block;
+    });
+    if (all.size() > n) {
+        all.resize(n);
+    }
+    return all;
+}
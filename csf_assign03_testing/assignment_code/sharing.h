@@ -0,0 +1,99 @@
+#ifndef SHARING_H
+#define SHARING_H
+
+#include <cstdint>
+#include <vector>
+#include "trace.h"
+
+// settings of the false-sharing detector (csim-share)
+struct SharingConfig {
+    unsigned blockSize = 64; // coherence granularity, at most 64 bytes
+    unsigned accessSize = 4; // bytes touched by every access
+    unsigned long window = 10000; // accesses per write-mask window
+};
+
+// what the detector found about one block
+struct SharedBlock {
+    uint32_t block; // block number (address / block size)
+    uint16_t threads; // threads that touched it
+    uint16_t writers; // threads that wrote it
+    unsigned long accesses;
+    unsigned long disjointWrites; // writes to bytes another thread's writes in the window left alone
+    unsigned long falseMisses; // coherence misses on bytes nobody else wrote
+    unsigned long trueMisses; // coherence misses on bytes another thread wrote
+};
+
+// finds false sharing in the interleaved accesses of several threads. every
+// thread keeps read and write byte masks per block that are cleared each
+// window, and a write that lands next to (but not on) the bytes another
+// thread wrote in the same window is flagged as disjoint. coherence misses
+// are estimated with write-invalidate at block granularity: a thread whose
+// copy was invalidated misses on its next access, and that miss is false
+// sharing if none of the bytes it touches were written by the others in the
+// meantime. per-thread block state and per-block totals live in two
+// open-addressing tables keyed by block (and thread)
+class SharingDetector {
+public:
+    static const unsigned MAX_THREADS = 16;
+
+    explicit SharingDetector(const SharingConfig &config);
+
+    void access(unsigned thread, const TraceRecord &rec);
+
+    unsigned long accesses() const { return index; }
+    unsigned long falseMisses() const { return totalFalse; }
+    unsigned long trueMisses() const { return totalTrue; }
+    unsigned long disjointWrites() const { return totalDisjoint; }
+    // blocks written by more than one thread
+    unsigned long sharedWrittenBlocks() const;
+
+    // the n worst blocks, by false sharing misses then disjoint writes
+    std::vector<SharedBlock> top(size_t n) const;
+
+private:
+    // a thread's view of one block
+    struct ThreadEntry {
+        uint64_t key; // (block << 4 | thread) + 1, 0 for an empty slot
+        uint64_t read; // byte masks of this window
+        uint64_t write;
+        uint64_t writtenSince; // bytes others wrote since our copy was invalidated
+        uint32_t window;
+        uint8_t flags;
+    };
+
+    struct BlockEntry {
+        uint64_t key; // block + 1, 0 for an empty slot
+        SharedBlock totals;
+    };
+
+    // linear probing over a power-of-two array, doubled at 3/4 full
+    template <typename Entry>
+    class Table {
+    public:
+        Table();
+        // the entry for key, inserted (zeroed) if it is not there yet. may move
+        // every entry, so pointers from earlier calls are stale afterwards
+        Entry &insert(uint64_t key);
+        // nullptr if absent, never moves anything
+        Entry *find(uint64_t key);
+        const std::vector<Entry> &slots() const { return entries; }
+
+    private:
+        size_t slot(uint64_t key) const;
+        void grow();
+
+        std::vector<Entry> entries;
+        size_t used = 0;
+    };
+
+    SharingConfig cfg;
+    unsigned blockBits;
+    Table<ThreadEntry> perThread;
+    Table<BlockEntry> blocks;
+    unsigned long index = 0;
+    unsigned long totalFalse = 0;
+    unsigned long totalTrue = 0;
+    unsigned long totalDisjoint = 0;
+};
+
+#endif
@@ -0,0 +1,186 @@
+// spatial footprint prefetcher in the style of Spatial Memory Streaming
+// (Somogyi et al., ISCA 2006). memory is cut into fixed-size regions. the
+// first access to a region that is not being tracked (the trigger) opens a
+// generation in the active generation table (AGT), which then records a
+// bitmap of the blocks touched. the generation ends when one of the region's
+// blocks leaves the cache (or the AGT needs the entry back), and the bitmap
+// is stored in a set-associative pattern history table (PHT) keyed by the
+// trigger offset. the next trigger with the same key prefetches that
+// footprint. the traces have no PC, so the key can optionally mix in low
+// region-number bits (--sms-key-bits) in place of SMS's PC
+#include "prefetch.h"
+
+using namespace std;
+
+namespace {
+
+unsigned log2u(unsigned n) {
+    unsigned bits = 0;
+    while ((1u << bits) < n) {
+        bits++;
+    }
+    return bits;
+}
+
+class SmsPrefetcher : public Prefetcher {
+public:
+    SmsPrefetcher(const PrefetchConfig &config, Arena &arena) {
+        regionBits = log2u(config.smsRegionSize / config.blockSize);
+        keyBits = config.smsKeyBits;
+        agtSize = config.smsAgtEntries;
+        phtSets = 1u << log2u(config.smsPhtSets);
+        phtWays = config.smsPhtWays;
+        agt = arena.make<Generation>(agtSize);
+        pht = arena.make<Pattern>((size_t) phtSets * phtWays);
+    }
+
+    const char *name() const override { return "sms"; }
+
+    void observe(uint32_t block, PrefetchEvent event, PrefetchQueue &out) override {
+        (void) event;
+        clock++;
+        uint32_t region = block >> regionBits;
+        unsigned offset = block & ((1u << regionBits) - 1);
+
+        // accesses inside an open generation just extend its footprint
+        Generation *g = findGeneration(region);
+        if (g != nullptr) {
+            g->footprint |= 1ull << offset;
+            g->lastUse = clock;
+            return;
+        }
+
+        // trigger access: open a generation, evicting the least recent one
+        g = &agt[0];
+        for (unsigned i = 0; i < agtSize; i++) {
+            if (!agt[i].valid) {
+                g = &agt[i];
+                break;
+            }
+            if (agt[i].lastUse < g->lastUse) {
+                g = &agt[i];
+            }
+        }
+        if (g->valid) {
+            learn(*g);
+        }
+        g->valid = true;
+        g->region = region;
+        g->trigger = offset;
+        g->footprint = 1ull << offset;
+        g->lastUse = clock;
+
+        // and stream in whatever this trigger touched last time
+        Pattern *p = findPattern(key(region, offset));
+        if (p == nullptr) {
+            return;
+        }
+        p->lastUse = clock;
+        uint64_t footprint = p->footprint & ~(1ull << offset);
+        uint32_t regionBase = region << regionBits;
+        // nearest blocks to the trigger first, so a small degree keeps the
+        // most likely ones
+        unsigned issued = 0;
+        unsigned blocks = 1u << regionBits;
+        for (unsigned d = 1; d < blocks && issued < degree; d++) {
+            unsigned around[2] = { offset + d, offset - d };
+            for (unsigned o : around) {
+                if (o < blocks && (footprint >> o & 1) && issued < degree) {
+                    out.push(regionBase | o);
+                    issued++;
+                }
+            }
+        }
+    }
+
+    void evicted(uint32_t block) override {
+        // losing any block of the region closes its generation
+        Generation *g = findGeneration(block >> regionBits);
+        if (g != nullptr) {
+            learn(*g);
+            g->valid = false;
+        }
+    }
+
+private:
+    struct Generation {
+        bool valid;
+        uint32_t region;
+        unsigned trigger;
+        uint64_t footprint;
+        uint64_t lastUse;
+    };
+
+    struct Pattern {
+        bool valid;
+        uint32_t key;
+        uint64_t footprint;
+        uint64_t lastUse;
+    };
+
+    uint32_t key(uint32_t region, unsigned offset) const {
+        uint32_t regionPart = region & ((1u << keyBits) - 1);
+        return (regionPart << regionBits) | offset;
+    }
+
+    Generation *findGeneration(uint32_t region) {
+        for (unsigned i = 0; i < agtSize; i++) {
+            if (agt[i].valid && agt[i].region == region) {
+                return &agt[i];
+            }
+        }
+        return nullptr;
+    }
+
+    Pattern *findPattern(uint32_t k) {
+        Pattern *set = pht + (size_t) (k & (phtSets - 1)) * phtWays;
+        for (unsigned i = 0; i < phtWays; i++) {
+            if (set[i].valid && set[i].key == k) {
+                return &set[i];
+            }
+        }
+        return nullptr;
+    }
+
+    // store a finished generation's footprint, replacing the LRU way
+    void learn(const Generation &g) {
+        uint32_t k = key(g.region, g.trigger);
+        Pattern *p = findPattern(k);
+        if (p == nullptr) {
+            Pattern *set = pht + (size_t) (k & (phtSets - 1)) * phtWays;
+            p = &set[0];
+            for (unsigned i = 0; i < phtWays; i++) {
+                if (!set[i].valid) {
+                    p = &set[i];
+                    break;
+                }
+                if (set[i].lastUse < p->lastUse) {
+                    p = &set[i];
+                }
+            }
+        }
+        p->valid = true;
+        p->key = k;
+        p->footprint = g.footprint;
+        p->lastUse = clock;
+    }
+
+    unsigned regionBits; // log2 of blocks per region
+    unsigned keyBits;
+    unsigned agtSize;
+    unsigned phtSets;
+    unsigned phtWays;
+    Generation *agt;
+    Pattern *pht;
+    uint64_t clock = 0;
+};
+
+}
+
+Prefetcher *makeSmsPrefetcher(const PrefetchConfig &config, Arena &arena) {
+    void *mem = arena.allocate(sizeof(SmsPrefetcher), alignof(SmsPrefetcher));
+    Prefetcher *p = new (mem) SmsPrefetcher(config, arena);
+    p->degree = config.smsDegree;
+    p->distance = config.distance;
+    return p;
+}
@@ -0,0 +1,75 @@
+/*
+ * Example replacement policy plugin: static RRIP (Jaleel et al., ISCA 2010).
+ * Build with make plugins and run with e.g.
+ *   ./csim 256 4 16 write-allocate write-back ./srrip.so:3 < trace
+ * where the optional argument is the number of RRPV bits (default 2).
+ */
+#include <stdlib.h>
+#include "csim_policy.h"
+
+typedef struct srrip {
+    uint32_t ways;
+    uint8_t max_rrpv;
+} srrip;
+
+static void *srrip_create(const csim_policy_config *config) {
+    int bits = config->args[0] ? atoi(config->args) : 2;
+    if (bits < 1 || bits > 7) {
+        return NULL;
+    }
+    srrip *p = config->alloc(config->arena, sizeof(srrip), _Alignof(srrip));
+    p->ways = config->ways;
+    p->max_rrpv = (uint8_t) ((1u << bits) - 1);
+    return p;
+}
+
+static void srrip_on_hit(void *ctx, const csim_access *access, uint8_t *set_meta,
+                         uint8_t *line_meta, uint32_t way) {
+    (void) ctx; (void) access; (void) set_meta;
+    line_meta[way] = 0; /* predicted near-immediate re-reference */
+}
+
+static void srrip_on_hit_batch(void *ctx, const csim_hit *hits, size_t count) {
+    (void) ctx;
+    for (size_t i = 0; i < count; i++) {
+        hits[i].line_meta[hits[i].way] = 0;
+    }
+}
+
+static void srrip_on_fill(void *ctx, const csim_access *access, uint8_t *set_meta,
+                          uint8_t *line_meta, uint32_t way) {
+    srrip *p = ctx;
+    (void) access; (void) set_meta;
+    line_meta[way] = (uint8_t) (p->max_rrpv - 1); /* long re-reference interval */
+}
+
+static uint32_t srrip_choose_victim(void *ctx, const csim_access *access, uint8_t *set_meta,
+                                    uint8_t *line_meta, uint32_t first_invalid) {
+    srrip *p = ctx;
+    (void) access; (void) set_meta;
+    if (first_invalid < p->ways) {
+        return first_invalid;
+    }
+    /* age the whole set until some line reaches the distant prediction */
+    for (;;) {
+        for (uint32_t i = 0; i < p->ways; i++) {
+            if (line_meta[i] >= p->max_rrpv) {
+                return i;
+            }
+        }
+        for (uint32_t i = 0; i < p->ways; i++) {
+            line_meta[i]++;
+        }
+    }
+}
+
+static const csim_policy srrip_policy = {
+    CSIM_POLICY_ABI_VERSION, 1, 0, "srrip",
+    srrip_create, NULL, NULL,
+    srrip_on_hit, srrip_on_fill, srrip_choose_victim,
+    srrip_on_hit_batch, NULL
+};
+
+const csim_policy *csim_policy_entry(void) {
+    return &srrip_policy;
+}
@@ -0,0 +1,215 @@
+#include <unistd.h>
+#include <chrono>
+#include <iomanip>
+#include <memory>
+#include "audit.h"
+#include "coroutine.h"
+#include "sweep.h"
+#include "thread_pool.h"
+
+using namespace std;
+
+namespace {
+
+const unsigned MIN_BLOCK = 4;
+const unsigned MAX_BLOCK = 512;
+// tiles never get smaller than this, however big the engines are
+const size_t MIN_TILE = 1024;
+
+size_t l2Bytes() {
+    long size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    return size > 0 ? (size_t) size : 1 << 20;
+}
+
+// one thread's share of the engines and where their state lives
+struct EngineGroup {
+    Arena arena;
+    vector<Cache *> engines;
+    vector<SimTask> tasks; // one per engine with the coroutine executor
+    ChunkFeed feed;
+};
+
+// walk the engines tile-major
+void runTiles(EngineGroup &group, span<const TraceRecord> records, size_t tile) {
+    for (size_t start = 0; start < records.size(); start += tile) {
+        size_t end = min(records.size(), start + tile);
+        for (Cache *engine : group.engines) {
+            for (size_t i = start; i < end; i++) {
+                engine->access(records[i]);
+            }
+        }
+    }
+    for (Cache *engine : group.engines) {
+        engine->finish();
+    }
+}
+
+// one configuration as a coroutine that takes a tile from the feed each time
+// it is resumed. the arena parameter is where its frame goes
+SimTask simulate(Arena &, Cache &cache, const ChunkFeed &feed) {
+    while (true) {
+        ChunkFeed::Chunk chunk = co_await feed;
+        if (chunk.begin == chunk.end) {
+            break;
+        }
+        for (const TraceRecord *rec = chunk.begin; rec != chunk.end; rec++) {
+            cache.access(*rec);
+        }
+    }
+    cache.finish();
+}
+
+// the same walk, but each engine is resumed as a coroutine per tile
+void runCoroutines(EngineGroup &group, span<const TraceRecord> records, size_t tile) {
+    const TraceRecord *base = records.data();
+    for (size_t start = 0; start < records.size(); start += tile) {
+        group.feed.set(base + start, base + min(records.size(), start + tile));
+        for (SimTask &task : group.tasks) {
+            task.resume();
+        }
+    }
+    group.feed.set(nullptr, nullptr);
+    for (SimTask &task : group.tasks) {
+        task.resume();
+    }
+}
+
+}
+
+size_t sweepTileRecords(size_t largestEngine, size_t l2) {
+    size_t room = l2 > largestEngine ? (l2 - largestEngine) / 2 : 0;
+    return max(room / sizeof(TraceRecord), MIN_TILE);
+}
+
+vector<CacheConfig> blockSweepConfigs(const CacheConfig &base, SweepMode mode) {
+    unsigned long capacity = (unsigned long) base.numSets * base.blocksPerSet * base.blockSize;
+    vector<CacheConfig> configs;
+    for (unsigned size = MIN_BLOCK; size <= MAX_BLOCK; size *= 2) {
+        CacheConfig config = base;
+        config.blockSize = size;
+        if (mode == SweepMode::CAPACITY) {
+            config.numSets = capacity / ((unsigned long) base.blocksPerSet * size);
+            if (config.numSets == 0) {
+                continue;
+            }
+        }
+        configs.push_back(config);
+    }
+    return configs;
+}
+
+SweepTiming runSweep(const vector<CacheConfig> &configs, span<const TraceRecord> records,
+                     unsigned threads, SweepExecutor executor, vector<SweepRow> &rows,
+                     Pinning pin) {
+    SweepTiming timing;
+    timing.executor = executor;
+    unique_ptr<ThreadPool> pool;
+    if (threads != 1) {
+        pool.reset(new ThreadPool(threads, pin));
+    }
+    timing.threads = pool ? pool->size() : 1;
+    if (timing.threads > configs.size()) {
+        timing.threads = configs.empty() ? 1 : configs.size();
+    }
+
+    // engines go round robin to the groups, each built in its group's arena
+    // so a thread's engines (and coroutine frames) are packed together
+    vector<unique_ptr<EngineGroup>> groups;
+    for (unsigned t = 0; t < timing.threads; t++) {
+        groups.emplace_back(new EngineGroup);
+    }
+    vector<Cache *> engines;
+    auto destroyEngines = [&engines] {
+        for (Cache *engine : engines) {
+            engine->~Cache();
+        }
+    };
+    try {
+        for (size_t i = 0; i < configs.size(); i++) {
+            EngineGroup &group = *groups[i % timing.threads];
+            size_t before = group.arena.bytesUsed();
+            void *mem = group.arena.allocate(sizeof(Cache), alignof(Cache));
+            Cache *engine = new (mem) Cache(configs[i], group.arena);
+            engines.push_back(engine);
+            group.engines.push_back(engine);
+            timing.largestEngine = max(timing.largestEngine, group.arena.bytesUsed() - before);
+        }
+    } catch (...) {
+        destroyEngines();
+        throw;
+    }
+    timing.tileRecords = sweepTileRecords(timing.largestEngine, l2Bytes());
+    if (executor == SweepExecutor::COROUTINES) {
+        for (unique_ptr<EngineGroup> &group : groups) {
+            for (Cache *engine : group->engines) {
+                group->tasks.push_back(simulate(group->arena, *engine, group->feed));
+            }
+        }
+    }
+    auto run = [&records, &timing, executor](EngineGroup &group) {
+        if (executor == SweepExecutor::COROUTINES) {
+            runCoroutines(group, records, timing.tileRecords);
+        } else {
+            runTiles(group, records, timing.tileRecords);
+        }
+    };
+
+    // the trace is decoded once and every thread walks it tile by tile.
+    // threaded runs allocate inside the pool, so only single-threaded
+    // sweeps are audited
+    // the frames and engines go before their arenas
+    auto destroyAll = [&groups, &destroyEngines] {
+        for (unique_ptr<EngineGroup> &group : groups) {
+            group->tasks.clear();
+        }
+        destroyEngines();
+    };
+    auto start = chrono::steady_clock::now();
+    try {
+        if (!pool) {
+            auditWarm();
+            run(*groups[0]);
+            auditDone();
+        } else {
+            for (unique_ptr<EngineGroup> &group : groups) {
+                EngineGroup *g = group.get();
+                pool->submit([&run, g] { run(*g); });
+            }
+            pool->wait();
+            timing.pool = pool->stats();
+        }
+    } catch (...) {
+        destroyAll();
+        throw;
+    }
+    timing.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    for (Cache *engine : engines) {
+        rows.push_back(SweepRow{engine->config(), engine->stats()});
+    }
+    destroyAll();
+    return timing;
+}
+
+void printSweep(const vector<SweepRow> &rows, const SweepTiming &timing, size_t records,
+                ostream &out) {
+    out << "Sets    Ways  Block  Alloc  Write  Policy      Load misses  Store misses  Miss rate  "
+           "Total cycles\n";
+    for (const SweepRow &r : rows) {
+        const CacheConfig &c = r.config;
+        unsigned long accesses = r.stats.totalLoads + r.stats.totalStores;
+        unsigned long misses = r.stats.loadMisses + r.stats.storeMisses;
+        out << left << setw(8) << c.numSets << setw(6) << c.blocksPerSet << setw(7) << c.blockSize
+            << setw(7) << (c.writeAllocate ? "wa" : "nwa") << setw(7) << (c.writeBack ? "wb" : "wt")
+            << setw(12) << c.policy->name << setw(13) << r.stats.loadMisses << setw(14)
+            << r.stats.storeMisses << setw(11) << fixed << setprecision(4)
+            << (accesses ? (double) misses / accesses : 0.0) << r.stats.cycles << "\n";
+    }
+    out << defaultfloat << setprecision(6);
+    out << "Sweep: " << rows.size() << " configs, " << records << " records, tiles of "
+        << timing.tileRecords << " records, largest engine " << timing.largestEngine << " bytes, "
+        << timing.threads << " threads"
+        << (timing.executor == SweepExecutor::COROUTINES ? ", coroutines" : "") << "\n";
+    out << "Records/s x configs: "
+        << (timing.seconds > 0 ? records * rows.size() / timing.seconds : 0.0) << "\n";
+}
@@ -0,0 +1,64 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include <ostream>
+#include <span>
+#include <vector>
+#include "cache.h"
+#include "thread_pool.h"
+#include "trace.h"
+
+// what stays fixed while the block size changes
+enum class SweepMode : uint8_t {
+    CAPACITY, // sets shrink as blocks grow
+    SETS // capacity grows with the blocks
+};
+
+// how each thread drives its engines
+enum class SweepExecutor : uint8_t {
+    TILES, // a plain loop over the engines for every tile
+    COROUTINES // every engine is a coroutine resumed once per tile
+};
+
+// one row of the sweep table
+struct SweepRow {
+    CacheConfig config;
+    CacheStats stats;
+};
+
+// how a sweep was scheduled and how long it took
+struct SweepTiming {
+    size_t tileRecords = 0; // records per tile
+    size_t largestEngine = 0; // bytes of the biggest engine's state
+    unsigned threads = 1;
+    SweepExecutor executor = SweepExecutor::TILES;
+    double seconds = 0;
+    ThreadPool::Stats pool; // idle and contention of the threads, if any
+};
+
+// base's geometry at every power-of-two block size from 4 to 512 bytes.
+// sizes that leave no whole set at a fixed capacity are skipped
+std::vector<CacheConfig> blockSweepConfigs(const CacheConfig &base, SweepMode mode);
+
+// records per tile for engines of up to largestEngine bytes: half of what
+// an l2 of that many bytes has left next to the engine's state, so bigger
+// engines get smaller tiles, but never fewer than 1024 records
+size_t sweepTileRecords(size_t largestEngine, size_t l2);
+
+// run every config over the decoded trace with one engine each, tile by tile:
+// a tile of records sized to stay in L2 next to the biggest engine's state
+// goes through every engine in turn before the next tile is touched. the
+// engines are split across threads (0 for one per core), each thread
+// walking its own engines tile by tile, with its engines (and with
+// COROUTINES their coroutine frames) packed in one arena, and pinned as
+// pin says. throws std::invalid_argument like the Cache constructor, and
+// passes on what an engine throws while it runs, from whichever thread
+SweepTiming runSweep(const std::vector<CacheConfig> &configs, std::span<const TraceRecord> records,
+                     unsigned threads, SweepExecutor executor, std::vector<SweepRow> &rows,
+                     Pinning pin = Pinning::NONE);
+
+// per-config misses and cycles, then the schedule and records/s x configs
+void printSweep(const std::vector<SweepRow> &rows, const SweepTiming &timing, size_t records,
+                std::ostream &out);
+
+#endif
@@ -0,0 +1,140 @@
+#include <pthread.h>
+#include <sched.h>
+#include <chrono>
+#include "thread_pool.h"
+
+using namespace std;
+
+namespace {
+
+uint64_t nowNanos() {
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+}
+
+ThreadPool::ThreadPool(unsigned threads, Pinning pin) {
+    if (threads == 0) {
+        threads = thread::hardware_concurrency();
+    }
+    if (threads == 0) {
+        threads = 1;
+    }
+    idleNanos.reset(new atomic<uint64_t>[threads]);
+    idleSince.reset(new atomic<uint64_t>[threads]);
+    for (unsigned i = 0; i < threads; i++) {
+        idleNanos[i] = 0;
+        idleSince[i] = 0;
+    }
+    for (unsigned i = 0; i < threads; i++) {
+        workers.emplace_back(&ThreadPool::work, this, i);
+    }
+    pinWorkers(pin);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        unique_lock<mutex> l = acquire();
+        stopping = true;
+    }
+    ready.notify_all();
+    for (thread &t : workers) {
+        t.join();
+    }
+}
+
+unique_lock<mutex> ThreadPool::acquire() {
+    unique_lock<mutex> l(lock, try_to_lock);
+    if (!l.owns_lock()) {
+        contended++;
+        l.lock();
+    }
+    return l;
+}
+
+void ThreadPool::submit(function<void()> task) {
+    {
+        unique_lock<mutex> l = acquire();
+        queue.push_back(move(task));
+    }
+    ready.notify_one();
+}
+
+void ThreadPool::wait() {
+    unique_lock<mutex> l = acquire();
+    idle.wait(l, [this] { return queue.empty() && running == 0; });
+    if (failure) {
+        exception_ptr thrown = failure;
+        failure = nullptr;
+        l.unlock();
+        rethrow_exception(thrown);
+    }
+}
+
+ThreadPool::Stats ThreadPool::stats() const {
+    Stats s;
+    s.tasks = tasks;
+    uint64_t now = nowNanos();
+    for (size_t i = 0; i < workers.size(); i++) {
+        uint64_t since = idleSince[i];
+        uint64_t nanos = idleNanos[i] + (since != 0 && since < now ? now - since : 0);
+        s.workerIdleSeconds.push_back(nanos / 1e9);
+        s.idleSeconds += nanos / 1e9;
+    }
+    s.contended = contended;
+    return s;
+}
+
+void ThreadPool::pinWorkers(Pinning pin) {
+    unsigned cpus = thread::hardware_concurrency();
+    if (pin == Pinning::NONE || cpus == 0) {
+        return;
+    }
+    for (size_t i = 0; i < workers.size(); i++) {
+        size_t cpu = pin == Pinning::COMPACT ? i % cpus : i * cpus / workers.size();
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        // best effort, a cpu outside our affinity mask just leaves it unpinned
+        pthread_setaffinity_np(workers[i].native_handle(), sizeof(set), &set);
+    }
+}
+
+void ThreadPool::work(unsigned index) {
+    unique_lock<mutex> l = acquire();
+    while (true) {
+        if (queue.empty() && !stopping) {
+            uint64_t start = nowNanos();
+            idleSince[index] = start;
+            ready.wait(l, [this] { return !queue.empty() || stopping; });
+            idleSince[index] = 0;
+            idleNanos[index] += nowNanos() - start;
+        }
+        if (queue.empty()) {
+            return; // stopping and nothing left
+        }
+        function<void()> task = move(queue.front());
+        queue.pop_front();
+        running++;
+        l.unlock();
+
+        // an exception would terminate the worker, it goes to wait instead
+        exception_ptr thrown;
+        try {
+            task();
+        } catch (...) {
+            thrown = current_exception();
+        }
+        tasks++;
+
+        l = acquire();
+        if (thrown && !failure) {
+            failure = thrown;
+        }
+        running--;
+        if (queue.empty() && running == 0) {
+            idle.notify_all();
+        }
+    }
+}
@@ -0,0 +1,75 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// where the workers may run
+enum class Pinning : uint8_t {
+    NONE, // wherever the scheduler puts them
+    COMPACT, // worker i on cpu i (mod the cpu count)
+    SPREAD // workers evenly spaced over the cpus
+};
+
+// a fixed set of worker threads pulling tasks off one shared queue. it counts
+// how long each worker sat waiting for work and how often one of them found
+// the queue lock already taken, so a harness can tell a starved pool from a
+// contended one
+class ThreadPool {
+public:
+    // 0 threads means one per core
+    explicit ThreadPool(unsigned threads = 0, Pinning pin = Pinning::NONE);
+    // finishes the queued tasks, then joins the workers
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    void submit(std::function<void()> task);
+    // block until every task submitted so far has finished, then rethrow the
+    // first exception a task let out since the last wait (the other tasks
+    // still run to the end)
+    void wait();
+
+    unsigned size() const { return (unsigned) workers.size(); }
+
+    struct Stats {
+        unsigned long tasks = 0; // tasks run to completion
+        double idleSeconds = 0; // summed over workers, waiting on an empty queue
+        std::vector<double> workerIdleSeconds; // the same per worker
+        unsigned long contended = 0; // lock acquisitions that had to wait
+    };
+    // a worker waiting right now counts the wait so far
+    Stats stats() const;
+
+private:
+    void work(unsigned index);
+    void pinWorkers(Pinning pin);
+    std::unique_lock<std::mutex> acquire();
+
+    std::mutex lock;
+    std::condition_variable ready; // a task was queued, or we are stopping
+    std::condition_variable idle; // the last running task finished
+    std::deque<std::function<void()>> queue;
+    std::vector<std::thread> workers;
+    unsigned running = 0;
+    bool stopping = false;
+    std::exception_ptr failure; // the first task exception since the last wait
+
+    std::atomic<unsigned long> tasks{0};
+    // per worker: idle nanoseconds so far, and when its current wait began
+    // (0 while it is busy)
+    std::unique_ptr<std::atomic<uint64_t>[]> idleNanos;
+    std::unique_ptr<std::atomic<uint64_t>[]> idleSince;
+    std::atomic<unsigned long> contended{0};
+};
+
+#endif
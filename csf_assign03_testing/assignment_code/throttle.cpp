@@ -0,0 +1,156 @@
+#include "throttle.h"
+
+using namespace std;
+
+namespace {
+
+// thresholds from the FDP paper
+const double ACCURACY_HIGH = 0.75;
+const double ACCURACY_LOW = 0.40;
+const double LATENESS = 0.01;
+const double POLLUTION = 0.005;
+
+// two Bloom filter bit positions for a block
+uint32_t filterHash1(uint32_t block) {
+    return (block * 2654435769u) >> 20;
+}
+
+uint32_t filterHash2(uint32_t block) {
+    return ((block ^ (block >> 13)) * 2246822519u) >> 20;
+}
+
+// scale a configured value for a level, level 3 keeps it as is
+unsigned scaled(unsigned base, unsigned level) {
+    unsigned long v = base;
+    if (level < 3) {
+        v >>= (3 - level);
+    } else {
+        v <<= (level - 3);
+    }
+    if (v < 1) {
+        v = 1;
+    }
+    if (v > PrefetchQueue::CAPACITY) {
+        v = PrefetchQueue::CAPACITY;
+    }
+    return (unsigned) v;
+}
+
+}
+
+PrefetchThrottle::PrefetchThrottle(Prefetcher *const *prefetchers, unsigned count,
+                                   unsigned long maxIntervals, Arena &arena)
+    : prefetchers(prefetchers), count(count), maxIntervals(maxIntervals) {
+    ctl = arena.make<Controller>(count);
+    timeline = arena.make<uint8_t>(maxIntervals * count);
+    for (unsigned i = 0; i < count; i++) {
+        ctl[i].level = 3;
+        ctl[i].baseDegree = prefetchers[i]->degree;
+        ctl[i].baseDistance = prefetchers[i]->distance;
+    }
+}
+
+void PrefetchThrottle::prefetchEvicted(unsigned source, uint32_t victim) {
+    uint64_t *filter = ctl[source].filter;
+    uint32_t a = filterHash1(victim) % FILTER_BITS;
+    uint32_t b = filterHash2(victim) % FILTER_BITS;
+    filter[a / 64] |= 1ull << (a % 64);
+    filter[b / 64] |= 1ull << (b % 64);
+}
+
+void PrefetchThrottle::demandMiss(uint32_t block) {
+    demandMisses++;
+    uint32_t a = filterHash1(block) % FILTER_BITS;
+    uint32_t b = filterHash2(block) % FILTER_BITS;
+    for (unsigned i = 0; i < count; i++) {
+        const uint64_t *filter = ctl[i].filter;
+        if ((filter[a / 64] >> (a % 64) & 1) && (filter[b / 64] >> (b % 64) & 1)) {
+            ctl[i].pollution++;
+        }
+    }
+}
+
+void PrefetchThrottle::intervalEnd(Cache &cache, unsigned long interval) {
+    (void) interval;
+    smoothedMisses = (smoothedMisses + demandMisses) / 2;
+    demandMisses = 0;
+
+    for (unsigned i = 0; i < count; i++) {
+        Controller &c = ctl[i];
+        const PrefetchStats &ps = cache.prefetchStats(i);
+        unsigned long issuedNow = ps.issued - c.lastIssued;
+        c.issued = (c.issued + (ps.issued - c.lastIssued)) / 2;
+        c.useful = (c.useful + (ps.useful - c.lastUseful)) / 2;
+        c.late = (c.late + (ps.late - c.lastLate)) / 2;
+        c.polluted = (c.polluted + c.pollution) / 2;
+        c.lastIssued = ps.issued;
+        c.lastUseful = ps.useful;
+        c.lastLate = ps.late;
+        c.pollution = 0;
+        for (uint64_t &word : c.filter) {
+            word = 0;
+        }
+
+        double accuracy = c.issued > 0 ? c.useful / c.issued : 0;
+        bool late = c.useful > 0 && c.late / c.useful > LATENESS;
+        bool polluting = smoothedMisses > 0 && c.polluted / smoothedMisses > POLLUTION;
+
+        // nothing issued this interval means nothing learned: the averages
+        // only halve stale counts, so creep back towards the default instead
+        // of stepping on them. otherwise the FDP decision table: accurate but
+        // late prefetches always speed up, pollution or poor accuracy backs off
+        int step = 0;
+        if (issuedNow == 0) {
+            step = c.level < 3 ? 1 : (c.level > 3 ? -1 : 0);
+        } else if (late && accuracy >= ACCURACY_HIGH) {
+            step = 1;
+        } else if (polluting) {
+            step = -1;
+        } else if (late) {
+            step = accuracy >= ACCURACY_LOW ? 1 : -1;
+        } else if (c.issued > 0 && accuracy < ACCURACY_LOW) {
+            step = -1;
+        }
+        if (step > 0 && c.level < LEVELS) {
+            c.level++;
+        } else if (step < 0 && c.level > 1) {
+            c.level--;
+        }
+        apply(i);
+
+        if (recorded < maxIntervals) {
+            timeline[recorded * count + i] = (uint8_t) c.level;
+        }
+    }
+    if (recorded < maxIntervals) {
+        recorded++;
+    }
+}
+
+void PrefetchThrottle::apply(unsigned i) {
+    prefetchers[i]->degree = scaled(ctl[i].baseDegree, ctl[i].level);
+    prefetchers[i]->distance = scaled(ctl[i].baseDistance, ctl[i].level);
+}
+
+void PrefetchThrottle::report(ostream &out) const {
+    for (unsigned i = 0; i < count; i++) {
+        unsigned long atLevel[LEVELS + 1] = {};
+        out << "Throttle " << prefetchers[i]->name() << " levels:";
+        unsigned long r = 0;
+        while (r < recorded) {
+            uint8_t level = timeline[r * count + i];
+            unsigned long run = 1;
+            while (r + run < recorded && timeline[(r + run) * count + i] == level) {
+                run++;
+            }
+            out << " " << (unsigned) level << "x" << run;
+            atLevel[level] += run;
+            r += run;
+        }
+        out << "\n";
+        for (unsigned level = 1; level <= LEVELS; level++) {
+            out << "Throttle " << prefetchers[i]->name() << " intervals at level " << level << ": "
+                << atLevel[level] << "\n";
+        }
+    }
+}
@@ -0,0 +1,68 @@
+#ifndef THROTTLE_H
+#define THROTTLE_H
+
+#include <cstdint>
+#include <ostream>
+#include "arena.h"
+#include "cache.h"
+#include "prefetch.h"
+
+// feedback-directed prefetch throttling (Srinath et al., HPCA 2007). at the
+// end of every interval each attached prefetcher is graded on accuracy
+// (useful / issued), lateness (late / useful) and pollution (demand misses
+// to blocks its prefetches evicted / demand misses, caught with a Bloom
+// filter), and its aggressiveness level moves up or down a step. the level
+// picks degree and distance relative to the configured ones, level 3 being
+// exactly the configured values
+class PrefetchThrottle : public IntervalObserver {
+public:
+    static const unsigned LEVELS = 5;
+
+    // maxIntervals bounds the recorded level timeline
+    PrefetchThrottle(Prefetcher *const *prefetchers, unsigned count, unsigned long maxIntervals,
+                     Arena &arena);
+
+    // a prefetch fill from the given prefetcher pushed victim out of the cache
+    void prefetchEvicted(unsigned source, uint32_t victim);
+    // a demand access missed on block
+    void demandMiss(uint32_t block);
+
+    void intervalEnd(Cache &cache, unsigned long interval) override;
+
+    // level timeline (run-length encoded) and time spent at each level
+    void report(std::ostream &out) const;
+
+private:
+    static const unsigned FILTER_BITS = 4096;
+
+    // per-prefetcher controller state
+    struct Controller {
+        unsigned level;
+        unsigned baseDegree;
+        unsigned baseDistance;
+        // counters at the end of the previous interval
+        unsigned long lastIssued;
+        unsigned long lastUseful;
+        unsigned long lastLate;
+        unsigned long pollution; // this interval's polluted demand misses
+        // smoothed (half old, half new) per-interval values
+        double issued;
+        double useful;
+        double late;
+        double polluted;
+        uint64_t filter[FILTER_BITS / 64];
+    };
+
+    void apply(unsigned i);
+
+    Prefetcher *const *prefetchers;
+    unsigned count;
+    Controller *ctl;
+    unsigned long demandMisses = 0; // this interval
+    double smoothedMisses = 0;
+    uint8_t *timeline; // level per interval, count entries per interval
+    unsigned long maxIntervals;
+    unsigned long recorded = 0;
+};
+
+#endif
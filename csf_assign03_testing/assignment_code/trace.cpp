@@ -0,0 +1,243 @@
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include "trace.h"
+
+using namespace std;
+
+namespace {
+
+// the parsing helpers all work on a [p, end) cursor over the whole trace text
+void skipSpace(const char *&p, const char *end) {
+    while (p < end && isspace((unsigned char) *p)) {
+        p++;
+    }
+}
+
+int hexDigit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+bool parseHex(const char *&p, const char *end, uint32_t &value) {
+    if (end - p >= 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+        p += 2;
+    }
+    const char *start = p;
+    uint32_t v = 0;
+    int d;
+    while (p < end && (d = hexDigit(*p)) >= 0) {
+        v = (v << 4) | (uint32_t) d;
+        p++;
+    }
+    value = v;
+    return p != start;
+}
+
+// saturates at MAX_GAP, the only decimal field is the gap
+bool parseDec(const char *&p, const char *end, uint32_t &value) {
+    const char *start = p;
+    uint32_t v = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        uint64_t next = (uint64_t) v * 10 + (uint32_t) (*p - '0');
+        v = next > MAX_GAP ? MAX_GAP : (uint32_t) next;
+        p++;
+    }
+    value = v;
+    return p != start;
+}
+
+// parse text records out of [p, end) until the input runs out, a line is
+// malformed, or sink returns false. returns where parsing stopped, which is
+// always the start of a line
+template <typename Sink>
+const char *parseText(const char *p, const char *end, Sink sink) {
+    while (true) {
+        skipSpace(p, end);
+        const char *line = p;
+        if (p == end) {
+            return p;
+        }
+        const char *op = p;
+        while (p < end && !isspace((unsigned char) *p)) {
+            p++;
+        }
+        size_t opLen = p - op;
+
+        TraceRecord rec;
+        skipSpace(p, end);
+        if (!parseHex(p, end, rec.addr)) {
+            return line;
+        }
+        skipSpace(p, end);
+        if (!parseDec(p, end, rec.gap)) {
+            return line;
+        }
+
+        // anything that is not a load or a store is ignored
+        if (opLen == 1 && (*op == 'l' || *op == 's')) {
+            rec.isStore = (*op == 's');
+            if (!sink(rec)) {
+                return p;
+            }
+        }
+    }
+}
+
+// error for the malformed line parseText stopped at, numbered from the
+// start of the text plus lines before it
+string malformedLine(const char *start, const char *line, unsigned long lines = 0) {
+    lines += count(start, line, '\n') + 1;
+    return "line " + to_string(lines) + " is not <op> <hex address> <gap>";
+}
+
+TraceRecord decodeBinary(const char *p) {
+    uint32_t word[2];
+    memcpy(word, p, sizeof(word));
+    TraceRecord rec;
+    rec.addr = word[0];
+    rec.gap = word[1] & ~BINARY_STORE_BIT;
+    rec.isStore = (word[1] & BINARY_STORE_BIT) != 0;
+    return rec;
+}
+
+}
+
+const char BINARY_TRACE_MAGIC[8] = {'C', 'S', 'I', 'M', 'T', 'R', 'C', '1'};
+
+bool readTrace(FILE *in, vector<TraceRecord> &records, string &error) {
+    // slurp the whole input first, it is much faster than stream extraction
+    vector<char> text;
+    if (!readTraceBytes(in, text)) {
+        error = "could not read the trace";
+        return false;
+    }
+    return decodeTrace(text.data(), text.size(), records, error);
+}
+
+bool readTraceBytes(FILE *in, vector<char> &bytes) {
+    char buf[1 << 16];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), in)) > 0) {
+        bytes.insert(bytes.end(), buf, buf + n);
+    }
+    return !ferror(in);
+}
+
+bool decodeTrace(const char *bytes, size_t size, vector<TraceRecord> &records, string &error) {
+    const char *p = bytes;
+    const char *end = p + size;
+    if (size >= sizeof(BINARY_TRACE_MAGIC) && memcmp(p, BINARY_TRACE_MAGIC, sizeof(BINARY_TRACE_MAGIC)) == 0) {
+        p += sizeof(BINARY_TRACE_MAGIC);
+        records.reserve(records.size() + (end - p) / 8);
+        for (; end - p >= 8; p += 8) {
+            records.push_back(decodeBinary(p));
+        }
+        return true;
+    }
+
+    // rough guess of ~14 bytes per line so the vector rarely regrows
+    records.reserve(records.size() + size / 14);
+    const char *stop = parseText(p, end, [&records](const TraceRecord &rec) {
+        records.push_back(rec);
+        return true;
+    });
+    if (stop != end) {
+        error = malformedLine(bytes, stop);
+        return false;
+    }
+    return true;
+}
+
+bool TraceReader::fill() {
+    // keep the unparsed tail and append the next piece of input
+    if (!binary) {
+        lines += count(buf.begin(), buf.begin() + pos, '\n');
+    }
+    buf.erase(buf.begin(), buf.begin() + pos);
+    pos = 0;
+    size_t have = buf.size();
+    buf.resize(have + (1 << 16));
+    size_t n = fread(buf.data() + have, 1, 1 << 16, in);
+    buf.resize(have + n);
+    if (n == 0) {
+        eof = true;
+        if (ferror(in)) {
+            message = "could not read the trace";
+        }
+    }
+    return n != 0;
+}
+
+bool TraceReader::next(RecordBatch &batch) {
+    batch.count = 0;
+    if (!started) {
+        while (buf.size() < sizeof(BINARY_TRACE_MAGIC) && fill()) {
+        }
+        binary = buf.size() >= sizeof(BINARY_TRACE_MAGIC) &&
+                 memcmp(buf.data(), BINARY_TRACE_MAGIC, sizeof(BINARY_TRACE_MAGIC)) == 0;
+        pos = binary ? sizeof(BINARY_TRACE_MAGIC) : 0;
+        started = true;
+    }
+
+    while (batch.count < RecordBatch::CAPACITY) {
+        if (binary) {
+            while (batch.count < RecordBatch::CAPACITY && buf.size() - pos >= 8) {
+                batch.records[batch.count++] = decodeBinary(buf.data() + pos);
+                pos += 8;
+            }
+        } else {
+            // only parse up to the last complete line until the input ends
+            const char *start = buf.data() + pos;
+            const char *end = buf.data() + buf.size();
+            if (!eof) {
+                while (end > start && end[-1] != '\n') {
+                    end--;
+                }
+            }
+            const char *stop = parseText(start, end, [&batch](const TraceRecord &rec) {
+                batch.records[batch.count++] = rec;
+                return batch.count < RecordBatch::CAPACITY;
+            });
+            pos = stop - buf.data();
+            if (batch.count < RecordBatch::CAPACITY && (stop != end || eof)) {
+                // a malformed line ends the trace, and fails it like readTrace
+                if (stop != end) {
+                    message = malformedLine(buf.data(), stop, lines);
+                }
+                pos = buf.size();
+                eof = true;
+            }
+        }
+        if (batch.count == RecordBatch::CAPACITY || eof || !fill()) {
+            break;
+        }
+    }
+    return batch.count != 0;
+}
+
+bool writeBinaryHeader(FILE *out) {
+    return fwrite(BINARY_TRACE_MAGIC, 1, sizeof(BINARY_TRACE_MAGIC), out) == sizeof(BINARY_TRACE_MAGIC);
+}
+
+bool writeRecords(FILE *out, const RecordBatch &batch, bool binary) {
+    if (binary) {
+        uint32_t words[2 * RecordBatch::CAPACITY];
+        for (size_t i = 0; i < batch.count; i++) {
+            const TraceRecord &rec = batch.records[i];
+            words[2 * i] = rec.addr;
+            uint32_t gap = rec.gap > MAX_GAP ? MAX_GAP : rec.gap;
+            words[2 * i + 1] = gap | (rec.isStore ? BINARY_STORE_BIT : 0);
+        }
+        return fwrite(words, 8, batch.count, out) == batch.count;
+    }
+    for (size_t i = 0; i < batch.count; i++) {
+        const TraceRecord &rec = batch.records[i];
+        if (fprintf(out, "%c 0x%08x %u\n", rec.isStore ? 's' : 'l', rec.addr, rec.gap) < 0) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,74 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// one decoded line of a memory trace
+struct TraceRecord {
+    uint32_t addr = 0; // byte address of the access
+    uint32_t gap = 0; // third trace field, instructions since the previous access
+    bool isStore = false; // 's' lines are stores, 'l' lines are loads
+};
+
+// binary traces start with these 8 bytes, followed by 8 bytes per record:
+// the address, then the gap with BINARY_STORE_BIT set for stores, both
+// little-endian
+extern const char BINARY_TRACE_MAGIC[8];
+const uint32_t BINARY_STORE_BIT = 1u << 31;
+// so a gap never reaches the store bit, longer gaps are read and written
+// as this one
+const uint32_t MAX_GAP = BINARY_STORE_BIT - 1;
+
+// read a whole trace into records, either text (lines of <l|s> <hex address>
+// <gap>, lines with any other op are skipped) or binary. returns false with
+// error set on a read error or on a text line that has no address or gap,
+// which error gives the number of
+bool readTrace(std::FILE *in, std::vector<TraceRecord> &records, std::string &error);
+
+// the two halves of readTrace: all of in's bytes, then the records decoded
+// from them
+bool readTraceBytes(std::FILE *in, std::vector<char> &bytes);
+bool decodeTrace(const char *bytes, size_t size, std::vector<TraceRecord> &records,
+                 std::string &error);
+
+// a run of records handed from one streaming stage to the next. stages work
+// on a batch in place, so records are only copied when they are read in
+struct RecordBatch {
+    static const size_t CAPACITY = 4096;
+    size_t count = 0;
+    TraceRecord records[CAPACITY];
+};
+
+// reads a text or binary trace a batch at a time
+class TraceReader {
+public:
+    explicit TraceReader(std::FILE *in) : in(in) {}
+
+    // refill batch, false once the input is used up, on a read error or at
+    // a malformed line (see readTrace). error says which it was
+    bool next(RecordBatch &batch);
+    bool failed() const { return !message.empty(); }
+    const std::string &error() const { return message; }
+
+private:
+    bool fill();
+
+    std::FILE *in;
+    std::vector<char> buf;
+    size_t pos = 0; // parse position in buf
+    bool started = false;
+    bool binary = false;
+    bool eof = false;
+    unsigned long lines = 0; // lines dropped from the front of buf
+    std::string message;
+};
+
+// append a batch to out as text lines or binary records, false on a write
+// error. binary output has to start with writeBinaryHeader
+bool writeRecords(std::FILE *out, const RecordBatch &batch, bool binary);
+bool writeBinaryHeader(std::FILE *out);
+
+#endif
@@ -0,0 +1,208 @@
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+#include "trace_stages.h"
+
+using namespace std;
+
+void BatchChannel::push(RecordBatch *batch) {
+    unique_lock<mutex> l(lock);
+    changed.wait(l, [this] { return batches.size() < capacity; });
+    batches.push_back(batch);
+    changed.notify_all();
+}
+
+RecordBatch *BatchChannel::pop() {
+    unique_lock<mutex> l(lock);
+    changed.wait(l, [this] { return !batches.empty() || closed; });
+    if (batches.empty()) {
+        return nullptr;
+    }
+    RecordBatch *batch = batches.front();
+    batches.pop_front();
+    changed.notify_all();
+    return batch;
+}
+
+void BatchChannel::close() {
+    lock_guard<mutex> l(lock);
+    closed = true;
+    changed.notify_all();
+}
+
+namespace {
+
+// the sum of two gaps, saturating at MAX_GAP
+uint32_t addGaps(uint32_t a, uint32_t b) {
+    uint64_t sum = (uint64_t) a + b;
+    return sum > MAX_GAP ? MAX_GAP : (uint32_t) sum;
+}
+
+// stages that keep or drop each record, compacting the batch in place
+class FilterStage : public TraceStage {
+public:
+    explicit FilterStage(bool carryGaps) : carryGaps(carryGaps) {}
+
+    void process(RecordBatch &batch) override {
+        size_t kept = 0;
+        for (size_t i = 0; i < batch.count; i++) {
+            TraceRecord rec = batch.records[i];
+            if (keep(rec)) {
+                rec.gap = addGaps(rec.gap, carry);
+                carry = 0;
+                batch.records[kept++] = rec;
+            } else if (carryGaps) {
+                carry = addGaps(carry, rec.gap);
+            }
+        }
+        batch.count = kept;
+    }
+
+protected:
+    virtual bool keep(const TraceRecord &rec) = 0;
+
+private:
+    bool carryGaps;
+    uint32_t carry = 0; // gaps of the records dropped since the last kept one
+};
+
+class RangeStage : public FilterStage {
+public:
+    RangeStage(uint32_t lo, uint32_t hi) : FilterStage(true), lo(lo), hi(hi) {}
+
+protected:
+    bool keep(const TraceRecord &rec) override { return rec.addr >= lo && rec.addr < hi; }
+
+private:
+    uint32_t lo, hi;
+};
+
+// records before the window are dropped without carrying their gaps, the
+// window starts fresh
+class SliceStage : public FilterStage {
+public:
+    SliceStage(unsigned long first, unsigned long last) : FilterStage(false), first(first), last(last) {}
+
+protected:
+    bool keep(const TraceRecord &) override {
+        unsigned long i = index++;
+        return i >= first && i < last;
+    }
+
+private:
+    unsigned long first, last;
+    unsigned long index = 0;
+};
+
+class SampleStage : public FilterStage {
+public:
+    explicit SampleStage(unsigned long every) : FilterStage(true), every(every) {}
+
+protected:
+    bool keep(const TraceRecord &) override { return index++ % every == 0; }
+
+private:
+    unsigned long every;
+    unsigned long index = 0;
+};
+
+class HashSampleStage : public FilterStage {
+public:
+    HashSampleStage(unsigned long buckets, unsigned bits) : FilterStage(true), buckets(buckets), bits(bits) {}
+
+protected:
+    bool keep(const TraceRecord &rec) override {
+        uint32_t h = (rec.addr >> bits) * 0x9e3779b9u;
+        h ^= h >> 16;
+        return h % buckets == 0;
+    }
+
+private:
+    unsigned long buckets;
+    unsigned bits;
+};
+
+class RemapStage : public TraceStage {
+public:
+    RemapStage(uint32_t from, uint32_t to, uint32_t size) : from(from), to(to), size(size) {}
+
+    void process(RecordBatch &batch) override {
+        for (size_t i = 0; i < batch.count; i++) {
+            uint32_t offset = batch.records[i].addr - from;
+            if (offset < size) {
+                batch.records[i].addr = to + offset;
+            }
+        }
+    }
+
+private:
+    uint32_t from, to, size;
+};
+
+// split "a<sep>b<sep>..." into whole numbers, false if any part is not one
+bool parseNumbers(const string &text, char sep, vector<unsigned long> &out) {
+    size_t start = 0;
+    while (true) {
+        size_t stop = text.find(sep, start);
+        string part = text.substr(start, stop == string::npos ? string::npos : stop - start);
+        char *end;
+        unsigned long v = strtoul(part.c_str(), &end, 0);
+        if (part.empty() || *end != '\0' || part[0] == '-') {
+            return false;
+        }
+        out.push_back(v);
+        if (stop == string::npos) {
+            return true;
+        }
+        start = stop + 1;
+    }
+}
+
+// addresses and windows have to stay inside the 32-bit address space, or
+// they would be cut down silently when the stage stores them
+const unsigned long ADDRESS_SPACE = 1ul << 32;
+
+bool addressesFit(const vector<unsigned long> &v) {
+    for (unsigned long x : v) {
+        if (x >= ADDRESS_SPACE) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
+unique_ptr<TraceStage> makeStage(const string &spec, string &error) {
+    size_t colon = spec.find(':');
+    string name = spec.substr(0, colon);
+    string args = colon == string::npos ? "" : spec.substr(colon + 1);
+    vector<unsigned long> v;
+
+    if (name == "range" && parseNumbers(args, '-', v) && v.size() == 2 && v[0] < v[1]) {
+        if (!addressesFit(v)) {
+            error = "stage '" + spec + "' goes past the 32-bit address space";
+            return nullptr;
+        }
+        return unique_ptr<TraceStage>(new RangeStage(v[0], v[1]));
+    }
+    if (name == "slice" && parseNumbers(args, '-', v) && v.size() == 2 && v[0] < v[1]) {
+        return unique_ptr<TraceStage>(new SliceStage(v[0], v[1]));
+    }
+    if (name == "sample" && parseNumbers(args, ':', v) && v.size() == 1 && v[0] > 0) {
+        return unique_ptr<TraceStage>(new SampleStage(v[0]));
+    }
+    if (name == "hash-sample" && parseNumbers(args, ':', v) && (v.size() == 1 || v.size() == 2) &&
+        v[0] > 0 && (v.size() == 1 || v[1] < 32)) {
+        return unique_ptr<TraceStage>(new HashSampleStage(v[0], v.size() == 2 ? v[1] : 6));
+    }
+    if (name == "remap" && parseNumbers(args, ':', v) && v.size() == 3 && v[2] > 0) {
+        if (!addressesFit(v) || v[0] + v[2] > ADDRESS_SPACE || v[1] + v[2] > ADDRESS_SPACE) {
+            error = "stage '" + spec + "' goes past the 32-bit address space";
+            return nullptr;
+        }
+        return unique_ptr<TraceStage>(new RemapStage(v[0], v[1], v[2]));
+    }
+    error = "bad stage '" + spec + "'";
+    return nullptr;
+}
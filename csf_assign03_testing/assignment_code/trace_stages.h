@@ -0,0 +1,59 @@
+#ifndef TRACE_STAGES_H
+#define TRACE_STAGES_H
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "trace.h"
+
+// the streaming stages of csim-trace. each stage runs on its own thread and
+// gets its batches through a BatchChannel from the stage before it. a batch
+// belongs to exactly one stage at a time, which edits it in place and passes
+// the pointer on, so records are not copied between stages
+
+// bounded FIFO of batch pointers between two threads
+class BatchChannel {
+public:
+    explicit BatchChannel(size_t capacity) : capacity(capacity) {}
+
+    // blocks while the channel is full
+    void push(RecordBatch *batch);
+    // blocks while the channel is empty, nullptr once it is closed and drained
+    RecordBatch *pop();
+    // no more pushes are coming
+    void close();
+
+private:
+    std::mutex lock;
+    std::condition_variable changed;
+    std::deque<RecordBatch *> batches;
+    size_t capacity;
+    bool closed = false;
+};
+
+// one transformation over the record stream
+class TraceStage {
+public:
+    virtual ~TraceStage() = default;
+
+    // rewrite the batch in place, dropping records by shrinking it
+    virtual void process(RecordBatch &batch) = 0;
+};
+
+// build a stage from its spec, nullptr with error set if the spec is bad:
+//   range:LO-HI          keep addresses in [LO, HI)
+//   slice:FIRST-LAST     keep records FIRST to LAST-1 of the stream
+//   sample:N             keep every N-th record
+//   hash-sample:N[:BITS] keep the blocks (addr >> BITS, 6 by default) that
+//                        hash into one of N buckets, so a kept block keeps
+//                        all of its reuse
+//   remap:FROM:TO:SIZE   move [FROM, FROM + SIZE) to start at TO
+// numbers may be hex (0x...) or decimal, and addresses (including HI and the
+// ends of both remap windows) have to fit in 32 bits. stages that drop
+// records add the dropped gaps, up to MAX_GAP, to the next record they keep
+// so the timing stays intact
+std::unique_ptr<TraceStage> makeStage(const std::string &spec, std::string &error);
+
+#endif
@@ -111,7 +111,7 @@ for config in "${configs[@]}"; do
 
     if [[ ! -f "$expected_output" ]]; then
         echo "ERROR: Expected result file missing: $expected_output"
-        echo "Run ./generate_expected_results_simple.sh first to create expected results"
+        echo "Run assignment_code/csim_test --generate first to create expected results"
         continue
     fi
 